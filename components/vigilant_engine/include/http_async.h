@@ -0,0 +1,41 @@
+// http_async.h
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs a request on a worker task. `req` is the detached copy from
+// httpd_req_async_handler_begin(); the pool completes it afterwards.
+// `accepted_at` is the esp_timer time at which httpd handed the request over.
+typedef esp_err_t (*http_async_fn_t)(httpd_req_t* req, void* ctx,
+                                     int64_t accepted_at);
+
+// Frees a job's `ctx` once the pool is done with the job.
+typedef void (*http_async_release_fn_t)(void* ctx);
+
+// Creates the request queue and CONFIG_VE_HTTP_ASYNC_WORKERS worker tasks.
+// Safe to call multiple times.
+esp_err_t http_async_start(void);
+
+// Detaches `req` from the httpd task and queues `fn` for a worker. Returns
+// ESP_OK once the request is queued or, if the queue is full, answered with
+// 503; the httpd handler then returns ESP_OK without touching `req` again.
+// Returns ESP_ERR_INVALID_STATE when the pool is not running, in which case
+// the caller should handle the request inline. With ESP_OK, `release` (may be
+// NULL) is called with `ctx` after `fn`, or instead of it for a 503.
+esp_err_t http_async_submit(httpd_req_t* req, http_async_fn_t fn, void* ctx,
+                            http_async_release_fn_t release);
+
+// Writes queue depth and overload counters for /metrics.
+void http_async_write_metrics(metrics_out_t* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+// http_cache.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// True if the request's If-None-Match is "*" or lists `etag` (a quoted ETag).
+// Lists too long to read count as no match; the client then just gets the
+// full response.
+bool http_cache_etag_matches(httpd_req_t* req, const char* etag);
+
+// True if an Accept-Encoding value allows gzip: it lists "gzip" (or
+// "x-gzip") or "*" without q=0. NULL, for a request without the header,
+// allows any encoding.
+bool http_cache_accepts_gzip(const char* accept_encoding);
+
+// Sends an embedded gzip-compressed page of content type `type`, with `etag`
+// for revalidation: 304 if the client has it already, 406 if the client does
+// not accept gzip (there is no uncompressed copy), the page otherwise. Also
+// compiled into the recovery app.
+esp_err_t http_cache_send_gzip(httpd_req_t* req, const char* type,
+                               const unsigned char* gz, size_t gz_size,
+                               const char* etag);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,54 @@
+// http_router.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Most "{name}" segments in one pattern
+#define HTTP_ROUTER_MAX_PARAMS 8
+
+// Path parameters of a matched URI in pattern order, as offsets into it.
+typedef struct {
+    uint8_t count;
+    struct {
+        uint16_t offset;
+        uint16_t len;
+    } values[HTTP_ROUTER_MAX_PARAMS];
+} http_router_params_t;
+
+// Creates the router's lock. http_server calls it before it adds or matches
+// a route; safe to call more than once, also from several tasks at a time.
+esp_err_t http_router_init(void);
+
+// Adds a route for `pattern` and `method` (HTTP_ANY matches every method).
+// Patterns are paths such as "/sensor/{id}/reg/{reg}", where "{name}" matches
+// any one segment. `pattern` must stay valid; `route` is what
+// http_router_match() returns. Fails with ESP_ERR_INVALID_STATE for a route
+// that exists already and ESP_ERR_NO_MEM once CONFIG_VE_HTTP_MAX_ENDPOINTS
+// routes are added, ESP_ERR_INVALID_STATE before http_router_init().
+esp_err_t http_router_add(const char* pattern, int method, void* route);
+
+// Returns the route for a request URI (the query string is ignored), or
+// NULL. Literal segments take precedence over parameters. `path_known` is
+// set when the path has a route for another method, i.e. a 405 not a 404.
+// `params` (may be NULL) receives the segments the parameters matched.
+void* http_router_match(const char* uri, int method, bool* path_known,
+                        http_router_params_t* params);
+
+// Finds the value of "{name}" in `pattern` among the `params` that
+// http_router_match() captured for `uri`. `value` is not null-terminated.
+bool http_router_param(const char* pattern, const http_router_params_t* params,
+                       const char* uri, const char* name, const char** value,
+                       size_t* value_len);
+
+#ifdef __cplusplus
+}
+#endif
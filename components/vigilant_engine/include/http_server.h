@@ -1,7 +1,12 @@
 // http_server.h
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "esp_err.h"
+#include "esp_http_server.h"
+#include "metrics.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,6 +24,34 @@ esp_err_t http_server_stop(void);
 // damit der Server bei Verbindungsänderungen neu gestartet/gestoppt wird.
 esp_err_t http_server_register_event_handlers(void);
 
+// Registers a URI handler like httpd_register_uri_handler() and counts its
+// requests and errors for /metrics. Use it for all engine handlers.
+esp_err_t http_server_register_uri(httpd_handle_t server,
+                                   const httpd_uri_t* uri);
+
+// Like http_server_register_uri(), but the handler runs on an http_async
+// worker task instead of the httpd task, so a slow handler does not hold up
+// other clients or websocket delivery. Requests beyond the queue depth get a
+// 503. The handler may block, but must not keep `req` after returning.
+esp_err_t http_server_register_async_uri(httpd_handle_t server,
+                                         const httpd_uri_t* uri);
+
+// Adds an endpoint to the engine's router instead of an httpd URI slot.
+// `uri->uri` may contain "{name}" path parameters. Backs
+// vigilant_register_endpoint() and vigilant_register_async_endpoint();
+// `async` works as for http_server_register_async_uri().
+esp_err_t http_server_register_endpoint(const httpd_uri_t* uri, bool async);
+
+// Copies the percent-decoded path parameter `name` of a routed request.
+// Backs vigilant_endpoint_param(). Call it from the endpoint's handler; the
+// parameters are recorded when the request is routed, for the task that runs
+// the handler.
+esp_err_t http_server_endpoint_param(httpd_req_t* req, const char* name,
+                                     char* value, size_t size);
+
+// Writes the per-URI request counters and the open socket gauge.
+void http_server_write_metrics(metrics_out_t* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "esp_err.h"
+#include "metrics.h"
 #include "vigilant_i2c_device.h"
 
 #ifdef __cplusplus
@@ -19,11 +20,27 @@ esp_err_t i2c_read_regs(VigilantI2CDevice* device, uint8_t reg, uint8_t* data,
                         size_t len);
 esp_err_t i2c_write_regs(VigilantI2CDevice* device, uint8_t reg,
                          const uint8_t* data, size_t len);
+// Read-modify-write under the bus mutex: bits in `mask` are set from
+// `value`, the others kept. Nothing is written if the register would not
+// change.
+esp_err_t i2c_update_bits(VigilantI2CDevice* device, uint8_t reg, uint8_t mask,
+                          uint8_t value);
+esp_err_t i2c_set_bits(VigilantI2CDevice* device, uint8_t reg, uint8_t bits);
+// Forgets all shadowed register values, e.g. after a device soft reset.
+void i2c_cache_invalidate(VigilantI2CDevice* device);
 esp_err_t i2c_whoami_check(VigilantI2CDevice* device);
+// Runs the entries in order without other engine transfers in between.
+// Stops at the first failing entry; the ones after it are not run and get
+// ESP_ERR_NOT_FINISHED. Returns the first error.
+esp_err_t i2c_transaction(VigilantI2COp* ops, size_t count);
 esp_err_t i2c_get_detected_devices(uint8_t* addresses, size_t max_addresses,
                                    size_t* count);
 void i2c_deinit(void);
 
+// Writes per-device transaction, NACK, timeout, byte and register cache
+// counters.
+void i2c_write_metrics(metrics_out_t* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,45 @@
+// i2c_async.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "metrics.h"
+#include "vigilant_i2c_device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Starts the I2C bus task and its request queues. Called by i2c_init().
+esp_err_t i2c_async_start(void);
+
+// Stops the bus task after the transfer in flight and completes every queued
+// transfer with ESP_ERR_INVALID_STATE. Later submissions fail until the next
+// i2c_async_start(). Called by i2c_deinit() before the bus is deleted.
+void i2c_async_stop(void);
+
+// Queue a register read or write for the bus task and return right away.
+// `data` must stay valid until the transfer completes, and the device must
+// not be removed while transfers for it are queued. Return ESP_ERR_NO_MEM if
+// the queue of `done->priority` is full and ESP_ERR_INVALID_STATE outside
+// i2c_init() and i2c_deinit(). Safe to call from any task.
+esp_err_t i2c_read_regs_async(VigilantI2CDevice* device, uint8_t reg,
+                              uint8_t* data, size_t len,
+                              const VigilantI2CAsync* done);
+esp_err_t i2c_write_regs_async(VigilantI2CDevice* device, uint8_t reg,
+                               const uint8_t* data, size_t len,
+                               const VigilantI2CAsync* done);
+
+// Queues a transaction list (see i2c_transaction()) as one request. `ops`
+// must stay valid until it completes; each entry's result is set by then.
+esp_err_t i2c_transaction_async(VigilantI2COp* ops, size_t count,
+                                const VigilantI2CAsync* done);
+
+// Writes queue depth, request and queue wait statistics per priority.
+void i2c_async_write_metrics(metrics_out_t* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,18 @@
+// i2c_bench.h
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Registers GET /i2cbench, which reads registers of one device with single
+// calls and with transaction lists, blocking and queued, and reports the
+// transfers per second of each. Only built with CONFIG_VE_I2C_BENCHMARK.
+esp_err_t i2c_bench_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
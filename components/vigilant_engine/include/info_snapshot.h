@@ -0,0 +1,34 @@
+// info_snapshot.h
+#pragma once
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest serialized /info body, with every string fully escaped
+#define INFO_SNAPSHOT_MAX 768
+#define INFO_SNAPSHOT_ETAG_MAX 16
+// The snapshot wrapped as a websocket "info" message
+#define INFO_SNAPSHOT_MESSAGE_MAX (INFO_SNAPSHOT_MAX + 32)
+
+// Rebuilds the serialized /info response from vigilant_get_info(). If it
+// changed, the ETag changes and an {"type":"info","info":{...}} message goes
+// to all websocket clients. Called on network events and config changes, so
+// GET /info never has to query the netifs itself.
+void info_snapshot_refresh(void);
+
+// Copies the current /info body (null-terminated) and its quoted ETag.
+// Returns ESP_ERR_INVALID_STATE before the first refresh.
+esp_err_t info_snapshot_get(char* body, size_t body_size, char* etag,
+                            size_t etag_size);
+
+// Formats the websocket "info" message for the current snapshot.
+esp_err_t info_snapshot_message(char* out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
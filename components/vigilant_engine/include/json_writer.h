@@ -0,0 +1,84 @@
+// json_writer.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Buffer size for json_writer_init_httpd(); responses of any size stream
+// through it in chunks.
+#define JSON_WRITER_HTTP_BUF 512
+#define JSON_WRITER_MAX_DEPTH 32
+// Longest string json_writer_stringf() formats
+#define JSON_WRITER_STRINGF_MAX 63
+
+// Called with the buffered output whenever the buffer is full, and once with
+// `final` set from json_writer_finish(). An error stops the writer.
+typedef esp_err_t (*json_writer_flush_fn)(void* ctx, const char* data,
+                                          size_t len, bool final);
+
+// Streaming JSON writer. Writes into a caller-owned buffer and never
+// allocates. Commas between members and elements are inserted automatically.
+// Errors are sticky: once a write fails, later calls do nothing and
+// json_writer_finish() returns the error. The struct is plain data, so a copy
+// taken before a write can be used to roll it back.
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t len;
+    json_writer_flush_fn flush;  // NULL: the output must fit into `buf`
+    void* ctx;
+    uint32_t has_items;  // bit per depth: a value was written at that depth
+    uint8_t depth;
+    bool after_key;
+    esp_err_t err;
+} json_writer_t;
+
+// Without `flush` the output must fit into `buf`; writes past the end fail
+// with ESP_ERR_NO_MEM.
+void json_writer_init(json_writer_t* w, char* buf, size_t cap,
+                      json_writer_flush_fn flush, void* ctx);
+
+// Streams the output as a chunked response on `req`. The caller sets the
+// content type before the first write.
+void json_writer_init_httpd(json_writer_t* w, httpd_req_t* req, char* buf,
+                            size_t cap);
+
+void json_writer_object_begin(json_writer_t* w);
+void json_writer_object_end(json_writer_t* w);
+void json_writer_array_begin(json_writer_t* w);
+void json_writer_array_end(json_writer_t* w);
+
+// Member name inside an object; the next value belongs to it.
+void json_writer_key(json_writer_t* w, const char* key);
+
+void json_writer_string(json_writer_t* w, const char* s);
+// Formatted string of at most JSON_WRITER_STRINGF_MAX characters. Longer
+// output is not cut but fails the writer with ESP_ERR_INVALID_SIZE.
+void json_writer_stringf(json_writer_t* w, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void json_writer_int(json_writer_t* w, int64_t v);
+void json_writer_uint(json_writer_t* w, uint64_t v);
+void json_writer_bool(json_writer_t* w, bool v);
+void json_writer_null(json_writer_t* w);
+
+// Shorthands for a key followed by a value.
+void json_writer_kv_string(json_writer_t* w, const char* key, const char* s);
+void json_writer_kv_int(json_writer_t* w, const char* key, int64_t v);
+void json_writer_kv_uint(json_writer_t* w, const char* key, uint64_t v);
+void json_writer_kv_bool(json_writer_t* w, const char* key, bool v);
+
+// Flushes the rest of the output, or null-terminates it in buffer mode if
+// there is room. Returns the first error the writer ran into.
+esp_err_t json_writer_finish(json_writer_t* w);
+
+#ifdef __cplusplus
+}
+#endif
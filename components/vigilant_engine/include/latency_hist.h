@@ -0,0 +1,42 @@
+// latency_hist.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log-scale latency buckets: bucket i counts durations of at most
+// LATENCY_HIST_MIN_US << i microseconds, the last one everything above
+// 16.7 s.
+#define LATENCY_HIST_MIN_SHIFT 5
+#define LATENCY_HIST_MIN_US (1u << LATENCY_HIST_MIN_SHIFT)
+#define LATENCY_HIST_BUCKETS 21
+
+// Lock-free latency histogram. Recording uses relaxed atomics only, so it
+// can be updated from any task and read while it is updated.
+typedef struct {
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_hist_t;
+
+void latency_hist_record(latency_hist_t* h, uint32_t us);
+
+// Upper bound in microseconds of bucket `i`, UINT32_MAX for the last one.
+uint32_t latency_hist_bucket_bound(size_t i);
+
+// Number of recorded durations.
+uint32_t latency_hist_count(const latency_hist_t* h);
+
+// Upper bound of the bucket holding percentile `pct` (0-100) of `total`
+// durations, capped at the largest one seen. Returns 0 for an empty
+// histogram. Accurate to a factor of two.
+uint32_t latency_hist_percentile(const latency_hist_t* h, uint32_t total,
+                                 uint32_t pct);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+// log_bench.h
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Registers GET /logbench, which captures log lines from one task per core,
+// once through a mutex protected line buffer like the original capture path
+// and once through the lock-free capture ring, and reports the lines per
+// second and the slowest single capture of each. Only built with
+// CONFIG_VE_LOG_BENCHMARK.
+esp_err_t log_bench_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
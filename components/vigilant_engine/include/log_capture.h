@@ -0,0 +1,61 @@
+// log_capture.h
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_HISTORY_LINES 200
+#define LOG_LINE_MAX 256
+
+typedef enum {
+    LOG_CAPTURE_OK = 0,   // line copied to the caller
+    LOG_CAPTURE_PENDING,  // sequence not yet written, try again later
+    LOG_CAPTURE_LOST,     // sequence was overwritten or dropped
+} log_capture_result_t;
+
+// Per-line metadata, recorded at capture time so readers can filter lines
+// without parsing the text.
+typedef struct {
+    uint8_t level;      // esp_log_level_t of the line, 0 if unknown
+    uint32_t tag_hash;  // log_capture_tag_hash() of the tag, 0 if unknown
+} log_capture_meta_t;
+
+// Appends one line to the capture ring. Lock-free multi-producer: safe to call
+// from any task on either core and never blocks. Returns false if the line was
+// dropped because its slot was still being written by a preempted producer.
+bool log_capture_push(const char* line);
+
+// Captures one esp_log line. Formats it right away, or with
+// CONFIG_VE_LOG_DEFERRED_FORMAT only stores the format pointer and the raw
+// argument words; the text is then produced by log_capture_read(). Has the
+// same non-blocking guarantees as log_capture_push().
+bool log_capture_vpush(const char* fmt, va_list ap);
+
+// Sequence number the next pushed line will receive. Sequence numbers start
+// at 1 and increase by one per captured line.
+uint32_t log_capture_next_seq(void);
+
+// Oldest sequence number that can still be present in the ring.
+uint32_t log_capture_oldest_seq(void);
+
+// Copies line `seq` into `out` (always null-terminated) and, if `meta` is not
+// NULL, its level and tag hash.
+log_capture_result_t log_capture_read(uint32_t seq, char* out,
+                                      size_t out_size,
+                                      log_capture_meta_t* meta);
+
+// Hash used for log_capture_meta_t.tag_hash (FNV-1a, never 0 for a tag).
+uint32_t log_capture_tag_hash(const char* tag);
+
+// Number of lines dropped by log_capture_push() since boot.
+uint32_t log_capture_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+// log_store.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Mounts the log partition (CONFIG_VE_LOG_FLASH_PARTITION) and starts the
+// background task that copies captured log lines to flash. Logging itself is
+// not slowed down: the task reads the capture ring on its own schedule.
+// Returns ESP_ERR_NOT_FOUND if the partition table has no log partition.
+esp_err_t log_store_init(void);
+
+// Writes all captured lines that are not yet in flash. Blocks on flash I/O,
+// never call it from the log path. Also runs as a shutdown handler so the
+// lines leading up to esp_restart() are kept.
+esp_err_t log_store_flush(void);
+
+// Registers GET /logs, which streams the stored log as text. Supports
+// "Range: bytes=..." requests.
+esp_err_t log_store_register_handlers(httpd_handle_t server);
+
+// Parses a Range header value of `total` bytes: "bytes=a-b", "bytes=a-" or
+// "bytes=-n". Returns false if it is not understood (the full log is sent
+// then). Otherwise sets [first, last], clipped to the log, or sets
+// `unsatisfiable` if no byte of the log is in range.
+bool log_store_parse_range(const char* value, uint32_t total,
+                           uint32_t* first, uint32_t* last,
+                           bool* unsatisfiable);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,62 @@
+// metrics.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Event counter with one slot per core. Each core only adds to its own slot
+// with a relaxed atomic add, so counting never takes a lock and cores do not
+// contend for the same word; readers sum the slots.
+typedef struct {
+    uint32_t per_core[portNUM_PROCESSORS];
+} metrics_counter_t;
+
+static inline void metrics_counter_add(metrics_counter_t* c, uint32_t n) {
+    __atomic_fetch_add(&c->per_core[xPortGetCoreID()], n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_counter_inc(metrics_counter_t* c) {
+    metrics_counter_add(c, 1);
+}
+
+uint32_t metrics_counter_read(const metrics_counter_t* c);
+
+// Output of a /metrics scrape in the Prometheus text format, streamed as a
+// chunked response.
+typedef struct {
+    httpd_req_t* req;
+    char buf[512];
+    size_t len;
+    esp_err_t err;
+} metrics_out_t;
+
+// Starts a metric family: writes its HELP and TYPE lines. `type` is
+// "counter", "gauge" or "histogram"; a histogram's samples are written with
+// the _bucket, _sum and _count suffixes.
+void metrics_family(metrics_out_t* out, const char* name, const char* type,
+                    const char* help);
+
+// Writes one sample. `labels` is the text between the braces, e.g.
+// `uri="/info"`, or NULL.
+void metrics_sample(metrics_out_t* out, const char* name, const char* labels,
+                    uint64_t value);
+
+// Copies `value` into `buf` as a label value, escaping '\\', '"' and
+// newlines. Returns the length of the escaped value like snprintf(), so a
+// result >= `size` means it was cut off.
+size_t metrics_escape_label(char* buf, size_t size, const char* value);
+
+// Registers GET /metrics.
+esp_err_t metrics_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,46 @@
+// sensors.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "metrics.h"
+#include "vigilant_i2c_device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Creates the poll timer. Called by i2c_init(); the poll task starts with
+// the first sensor, or right away if sensors_stop() stopped it.
+esp_err_t sensors_init(void);
+
+// Stops the poll task after the read in flight, and the poll timer. Sensors
+// stay registered; sensors_init() resumes polling them. Called by
+// i2c_deinit() before the bus is deleted.
+void sensors_stop(void);
+
+// Starts polling a register block at `config->rate_hz` and returns its id in
+// `id`. Sensors cannot be removed. Returns ESP_ERR_NO_MEM once
+// CONFIG_VE_SENSOR_MAX sensors are added.
+esp_err_t sensors_add(const VigilantSensorConfig* config, int* id);
+
+// True if a sensor polls `device`; such a device must stay on the bus.
+bool sensors_use_device(const VigilantI2CDevice* device);
+
+// Copies the latest sample of a sensor without touching the bus. Returns
+// ESP_ERR_NOT_FOUND for an unknown id and ESP_ERR_INVALID_STATE before its
+// first successful read. Safe to call from any task.
+esp_err_t sensors_latest(int id, VigilantSensorSample* out);
+
+// Registers GET /sensors, the latest sample of every sensor as JSON.
+esp_err_t sensors_register_handlers(httpd_handle_t server);
+
+// Writes read, error and overrun counters per sensor.
+void sensors_write_metrics(metrics_out_t* out);
+
+#ifdef __cplusplus
+}
+#endif
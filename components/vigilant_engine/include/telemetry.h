@@ -0,0 +1,64 @@
+// telemetry.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary websocket frames carry a batch of samples, all little-endian:
+//   frame:  u8 version, u8 record count, u16 reserved (0),
+//           u64 base timestamp (esp_timer us)
+//   record: u16 topic, u16 payload length, u32 topic sequence,
+//           u32 timestamp offset from the frame base (us), payload bytes
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_FRAME_HEADER 12
+#define TELEMETRY_RECORD_HEADER 12
+#define TELEMETRY_TOPIC_NAME_MAX 24
+
+// One published sample as queued for the websocket drain task.
+typedef struct {
+    uint16_t topic;
+    uint16_t len;
+    uint32_t seq;  // per topic, counts every publish (also unsent ones)
+    int64_t timestamp_us;
+    uint8_t data[CONFIG_VE_TELEMETRY_MAX_PAYLOAD];
+} telemetry_record_t;
+
+// Creates the sample queue. Safe to call multiple times.
+esp_err_t telemetry_init(void);
+
+// Gives a topic id a name for "telemetry-topics". Topics that are published
+// without being registered are listed without a name.
+esp_err_t telemetry_register_topic(uint16_t topic, const char* name);
+
+// Copies one sample into the queue, stamped with the current time. Returns
+// ESP_OK without queueing while no client subscribes to any topic, and
+// ESP_ERR_NO_MEM if the queue is full (the sample is dropped and counted).
+// Does not block; safe to call from any task.
+esp_err_t telemetry_publish(uint16_t topic, const void* data, size_t len);
+
+// Takes the next queued sample, if any. Websocket drain task only.
+bool telemetry_receive(telemetry_record_t* out);
+
+// Number of websocket clients that subscribe to at least one topic. Samples
+// are only queued while this is non-zero.
+void telemetry_set_listeners(uint32_t count);
+
+// Writes the known topics as a JSON array of {id, name, seq}.
+void telemetry_write_topics(json_writer_t* w);
+
+// Writes publish and drop counters for /metrics.
+void telemetry_write_metrics(metrics_out_t* out);
+
+#ifdef __cplusplus
+}
+#endif
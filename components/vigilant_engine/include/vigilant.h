@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "esp_err.h"
+#include "esp_http_server.h"
 #include "vigilant_i2c_device.h"
 
 #ifdef __cplusplus
@@ -52,7 +53,55 @@ esp_err_t vigilant_i2c_read_regs(VigilantI2CDevice* device, uint8_t reg,
                                  uint8_t* data, size_t len);
 esp_err_t vigilant_i2c_write_regs(VigilantI2CDevice* device, uint8_t reg,
                                   const uint8_t* data, size_t len);
+// Change some bits of a register without other engine transfers in between.
+// With a register cache on the device, this can take no bus transfer at all.
+esp_err_t vigilant_i2c_update_bits(VigilantI2CDevice* device, uint8_t reg,
+                                   uint8_t mask, uint8_t value);
+esp_err_t vigilant_i2c_set_bits(VigilantI2CDevice* device, uint8_t reg,
+                                uint8_t bits);
+void vigilant_i2c_cache_invalidate(VigilantI2CDevice* device);
 esp_err_t vigilant_i2c_whoami_check(VigilantI2CDevice* device);
+// Queue a transfer for the I2C bus task and return without waiting for the
+// bus. `data` must stay valid until `done` reports completion.
+esp_err_t vigilant_i2c_read_regs_async(VigilantI2CDevice* device, uint8_t reg,
+                                       uint8_t* data, size_t len,
+                                       const VigilantI2CAsync* done);
+esp_err_t vigilant_i2c_write_regs_async(VigilantI2CDevice* device,
+                                        uint8_t reg, const uint8_t* data,
+                                        size_t len,
+                                        const VigilantI2CAsync* done);
+// Runs a list of reads, writes and delays back to back, without other engine
+// transfers in between. Each entry gets its own result.
+esp_err_t vigilant_i2c_transaction(VigilantI2COp* ops, size_t count);
+esp_err_t vigilant_i2c_transaction_async(VigilantI2COp* ops, size_t count,
+                                         const VigilantI2CAsync* done);
+// Lets the engine read a register block at a fixed rate. The latest sample
+// is read with vigilant_sensor_latest() and shown on GET /sensors.
+esp_err_t vigilant_sensor_add(const VigilantSensorConfig* config, int* id);
+esp_err_t vigilant_sensor_latest(int id, VigilantSensorSample* sample);
+
+// Registers an HTTP endpoint for application code. `endpoint->uri` may hold
+// path parameters such as "/sensor/{id}/reg/{reg}", read with
+// vigilant_endpoint_param(). Endpoints are matched by the engine's router and
+// do not take up httpd URI handler slots. Can be called before or after
+// vigilant_init().
+esp_err_t vigilant_register_endpoint(const httpd_uri_t* endpoint);
+// Like vigilant_register_endpoint(), but the handler runs on an HTTP worker
+// task instead of the httpd task, so it may block on slow peripherals. When
+// the worker queue is full, the request is answered with 503.
+esp_err_t vigilant_register_async_endpoint(const httpd_uri_t* endpoint);
+// Copies path parameter `name` of the current request, percent-decoded and
+// null-terminated. ESP_ERR_NOT_FOUND if the endpoint has no such parameter
+// or when not called from the endpoint's handler.
+esp_err_t vigilant_endpoint_param(httpd_req_t* req, const char* name,
+                                  char* value, size_t size);
+
+// Names a telemetry topic for the "telemetry-topics" websocket command.
+esp_err_t vigilant_telemetry_register_topic(uint16_t topic, const char* name);
+// Queues one binary sample for websocket clients subscribed to `topic`. Does
+// not block and does not format anything; safe to call from control loops.
+esp_err_t vigilant_telemetry_publish(uint16_t topic, const void* data,
+                                     size_t len);
 
 #ifdef __cplusplus
 }
@@ -1,20 +1,106 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "driver/i2c_master.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Registers `first` to `last`, both included.
+typedef struct {
+    uint8_t first;
+    uint8_t last;
+} VigilantI2CRegRange;
+
+// Optional RAM copy of a device's configuration registers. Reads of a
+// cacheable register are served from it once the value is known, and writes
+// that would not change a register are skipped. Registers the device changes
+// by itself (status, data, FIFO) belong in `volatile_ranges`, which wins over
+// `cacheable`. Multi-byte transfers are assumed to auto-increment the
+// register address.
+typedef struct {
+    const VigilantI2CRegRange* cacheable;
+    size_t cacheable_count;
+    const VigilantI2CRegRange* volatile_ranges;
+    size_t volatile_count;
+    uint8_t values[256];  // engine only
+    uint32_t valid[8];    // engine only, one bit per register
+} VigilantI2CRegCache;
+
 typedef struct {
     uint16_t address;
     uint8_t whoami_reg;
     uint8_t expected_whoami;
     i2c_master_dev_handle_t handle;
+    VigilantI2CRegCache* cache;  // NULL for none; emptied by add_device
 } VigilantI2CDevice;
 
+// One step of a transaction list, see vigilant_i2c_transaction().
+typedef enum {
+    VIGILANT_I2C_OP_READ = 0,  // read `len` bytes from `reg` into `rx`
+    VIGILANT_I2C_OP_WRITE,     // write `len` bytes from `tx` to `reg`
+    VIGILANT_I2C_OP_DELAY,     // wait `delay_us`, keeping the bus
+} VigilantI2COpType;
+
+typedef struct {
+    VigilantI2COpType type;
+    VigilantI2CDevice* device;  // unused for delays
+    uint8_t reg;
+    uint8_t* rx;
+    const uint8_t* tx;
+    size_t len;
+    uint32_t delay_us;
+    esp_err_t result;  // set by the run; ESP_ERR_NOT_FINISHED if skipped
+} VigilantI2COp;
+
+// Largest register block a polled sensor can read.
+#define VIGILANT_SENSOR_MAX_LEN 32
+
+// A register block the engine reads at a fixed rate, see
+// vigilant_sensor_add().
+typedef struct {
+    const char* name;           // shown on /sensors, copied
+    VigilantI2CDevice* device;  // must stay added while it is polled
+    uint8_t reg;
+    uint8_t len;  // 1 to VIGILANT_SENSOR_MAX_LEN
+    uint32_t rate_hz;
+} VigilantSensorConfig;
+
+// Latest successful read of a polled sensor.
+typedef struct {
+    uint8_t data[VIGILANT_SENSOR_MAX_LEN];
+    uint8_t len;
+    uint32_t seq;          // counts successful reads, 1 for the first
+    int64_t timestamp_us;  // esp_timer time the read started
+} VigilantSensorSample;
+
+// Queued transfers of the higher priority run first. A transfer that is
+// already on the bus is not interrupted.
+typedef enum {
+    VIGILANT_I2C_PRIORITY_LOW = 0,
+    VIGILANT_I2C_PRIORITY_HIGH,
+} VigilantI2CPriority;
+
+// Runs on the I2C bus task when a queued transfer is done. The next transfer
+// waits for it, so it should only hand the result on.
+typedef void (*VigilantI2CCallback)(VigilantI2CDevice* device, esp_err_t err,
+                                    void* arg);
+
+// How a queued transfer reports completion. Any combination may be used.
+typedef struct {
+    VigilantI2CPriority priority;
+    VigilantI2CCallback callback;  // NULL for none
+    void* arg;                     // passed to `callback`
+    esp_err_t* result;             // written before completion, may be NULL
+    TaskHandle_t notify_task;      // gets a task notification, may be NULL
+} VigilantI2CAsync;
+
 #ifdef __cplusplus
 }
 #endif
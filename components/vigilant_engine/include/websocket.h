@@ -3,20 +3,42 @@
 
 #include "esp_err.h"
 #include "esp_http_server.h"
+#include "metrics.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct {
+    uint32_t calls;     // log calls seen by the capture hook
+    uint32_t total_us;  // time spent in the hook, excluding the UART output
+    uint32_t max_us;    // slowest single call
+    uint32_t dropped;   // lines the capture ring had to drop
+} websocket_log_stats_t;
+
 // Initialize log capture so ESP-IDF logs are buffered and can be forwarded
 // to websocket clients. Safe to call multiple times.
 void websocket_init_log_capture(void);
 
-// Registers websocket URI handlers on the provided HTTP server. Also passes
-// the server handle to the websocket module so captured logs can be delivered
-// to connected clients.
+// Registers the /ws websocket and the /events Server-Sent Events handlers on
+// the provided HTTP server. Also passes the server handle to the websocket
+// module so captured logs can be delivered to connected clients.
 esp_err_t websocket_register_handlers(httpd_handle_t server);
 
+// Copies the cost of the log capture hook since boot.
+void websocket_get_log_stats(websocket_log_stats_t* out);
+
+// Queues a text message to every connected client. Safe to call from any
+// task; clients over their send budget skip it.
+void websocket_broadcast(const char* text);
+
+// Wakes the drain task to send queued telemetry samples. Called by
+// telemetry_publish().
+void websocket_telemetry_pending(void);
+
+// Writes client, queue and frame metrics for /metrics.
+void websocket_write_metrics(metrics_out_t* out);
+
 // Removes the socket from the websocket client table when HTTPD closes it.
 void websocket_client_closed(int fd);
 
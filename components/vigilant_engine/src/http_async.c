@@ -0,0 +1,171 @@
+#include "http_async.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+static const char* TAG_ASYNC = "http_async";
+
+#define HTTP_ASYNC_TIMEOUT_US ((int64_t)CONFIG_VE_HTTP_ASYNC_TIMEOUT_MS * 1000)
+// Same as the httpd task (HTTPD_DEFAULT_CONFIG), so offloaded requests are
+// neither favoured nor starved compared to inline ones.
+#define HTTP_ASYNC_WORKER_PRIORITY (tskIDLE_PRIORITY + 5)
+
+typedef struct {
+    httpd_req_t* req;  // detached copy, owned by the job
+    http_async_fn_t fn;
+    void* ctx;
+    http_async_release_fn_t release;
+    int64_t accepted_at;
+} http_async_job_t;
+
+static QueueHandle_t s_queue = NULL;
+static metrics_counter_t s_accepted;
+static metrics_counter_t s_rejected;  // queue full: 503 right away
+static metrics_counter_t s_expired;   // waited past the timeout: 503
+static metrics_counter_t s_overran;   // ran past the timeout
+
+static esp_err_t send_unavailable(httpd_req_t* req, const char* msg) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    return httpd_resp_sendstr(req, msg);
+}
+
+static void http_async_worker(void* arg) {
+    (void)arg;
+    http_async_job_t job;
+    for (;;) {
+        if (xQueueReceive(s_queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // The client has likely given up on a request that waited this long;
+        // answering it quickly frees the worker for the ones behind it.
+        int64_t start = esp_timer_get_time();
+        if (start - job.accepted_at > HTTP_ASYNC_TIMEOUT_US) {
+            metrics_counter_inc(&s_expired);
+            ESP_LOGW(TAG_ASYNC, "%s expired after %" PRId64 " ms in queue",
+                     job.req->uri, (start - job.accepted_at) / 1000);
+            (void)send_unavailable(job.req, "Request timed out in queue");
+        } else {
+            (void)job.fn(job.req, job.ctx, job.accepted_at);
+
+            // A running handler cannot be interrupted; report the overrun so
+            // the handler can be fixed.
+            int64_t ran = esp_timer_get_time() - start;
+            if (ran > HTTP_ASYNC_TIMEOUT_US) {
+                metrics_counter_inc(&s_overran);
+                ESP_LOGW(TAG_ASYNC, "%s ran for %" PRId64 " ms", job.req->uri,
+                         ran / 1000);
+            }
+        }
+
+        if (job.release) job.release(job.ctx);
+        httpd_req_async_handler_complete(job.req);
+    }
+}
+
+esp_err_t http_async_start(void) {
+    // With no workers, async handlers simply run on the httpd task
+    if (CONFIG_VE_HTTP_ASYNC_WORKERS == 0 || s_queue) return ESP_OK;
+
+    s_queue = xQueueCreate(CONFIG_VE_HTTP_ASYNC_QUEUE_DEPTH,
+                           sizeof(http_async_job_t));
+    if (!s_queue) {
+        ESP_LOGE(TAG_ASYNC, "queue create failed, handlers run inline");
+        return ESP_ERR_NO_MEM;
+    }
+
+    int started = 0;
+    for (int i = 0; i < CONFIG_VE_HTTP_ASYNC_WORKERS; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "ve_httpd_w%d", i);
+        if (xTaskCreate(http_async_worker, name,
+                        CONFIG_VE_HTTP_ASYNC_WORKER_STACK, NULL,
+                        HTTP_ASYNC_WORKER_PRIORITY, NULL) == pdPASS) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        // Nothing would ever drain the queue; keep handlers inline instead
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        ESP_LOGE(TAG_ASYNC, "no worker task started, handlers run inline");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG_ASYNC, "%d worker(s), queue depth %d", started,
+             CONFIG_VE_HTTP_ASYNC_QUEUE_DEPTH);
+    return ESP_OK;
+}
+
+// Answers a request that cannot be queued; the pool is done with `ctx`.
+static esp_err_t reject(httpd_req_t* req, void* ctx,
+                        http_async_release_fn_t release) {
+    metrics_counter_inc(&s_rejected);
+    (void)send_unavailable(req, "Server busy");
+    if (release) release(ctx);
+    return ESP_OK;
+}
+
+esp_err_t http_async_submit(httpd_req_t* req, http_async_fn_t fn, void* ctx,
+                            http_async_release_fn_t release) {
+    if (!s_queue) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Check for room first: a detached request that cannot be queued would
+    // have to be answered and completed again.
+    if (uxQueueSpacesAvailable(s_queue) == 0) {
+        return reject(req, ctx, release);
+    }
+
+    http_async_job_t job = {
+        .req = NULL,
+        .fn = fn,
+        .ctx = ctx,
+        .release = release,
+        .accepted_at = esp_timer_get_time(),
+    };
+    if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+        return reject(req, ctx, release);
+    }
+
+    // Only the httpd task submits, so the slot checked above is still free;
+    // handled anyway rather than leaking the detached request.
+    if (xQueueSend(s_queue, &job, 0) != pdTRUE) {
+        (void)reject(job.req, ctx, release);
+        httpd_req_async_handler_complete(job.req);
+        return ESP_OK;
+    }
+    metrics_counter_inc(&s_accepted);
+    return ESP_OK;
+}
+
+void http_async_write_metrics(metrics_out_t* out) {
+    metrics_family(out, "ve_http_async_queued", "gauge",
+                   "Offloaded requests waiting for a worker");
+    metrics_sample(out, "ve_http_async_queued", NULL,
+                   s_queue ? uxQueueMessagesWaiting(s_queue) : 0);
+
+    metrics_family(out, "ve_http_async_requests_total", "counter",
+                   "Offloaded requests; expired ones were also queued");
+    metrics_sample(out, "ve_http_async_requests_total", "outcome=\"queued\"",
+                   metrics_counter_read(&s_accepted));
+    metrics_sample(out, "ve_http_async_requests_total", "outcome=\"rejected\"",
+                   metrics_counter_read(&s_rejected));
+    metrics_sample(out, "ve_http_async_requests_total", "outcome=\"expired\"",
+                   metrics_counter_read(&s_expired));
+
+    metrics_family(out, "ve_http_async_overruns_total", "counter",
+                   "Offloaded handlers that ran past the timeout");
+    metrics_sample(out, "ve_http_async_overruns_total", NULL,
+                   metrics_counter_read(&s_overran));
+}
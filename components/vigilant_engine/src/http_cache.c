@@ -0,0 +1,96 @@
+#include "http_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HTTP_CACHE_HDR_MAX 128
+
+bool http_cache_etag_matches(httpd_req_t* req, const char* etag) {
+    char value[HTTP_CACHE_HDR_MAX];
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (len == 0 || len >= sizeof(value) ||
+        httpd_req_get_hdr_value_str(req, "If-None-Match", value,
+                                    sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    return strcmp(value, "*") == 0 || strstr(value, etag) != NULL;
+}
+
+// False if the parameters of one "coding;q=x" entry, up to `end`, exclude it.
+static bool coding_allowed(const char* params, const char* end) {
+    for (const char* p = params; p + 1 < end; ++p) {
+        bool starts = p == params || p[-1] == ';' || p[-1] == ' ';
+        if (starts && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+            return strtod(p + 2, NULL) > 0.0;
+        }
+    }
+    return true;
+}
+
+bool http_cache_accepts_gzip(const char* accept_encoding) {
+    if (!accept_encoding) {
+        return true;
+    }
+
+    int gzip = -1;  // -1 not listed, else 0 or 1
+    int any = -1;
+    const char* p = accept_encoding;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') ++p;
+        const char* name = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') ++p;
+        size_t name_len = (size_t)(p - name);
+        const char* end = strchr(p, ',');
+        if (!end) end = p + strlen(p);
+
+        bool allowed = coding_allowed(p, end);
+        if ((name_len == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+            (name_len == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+            gzip = allowed;
+        } else if (name_len == 1 && name[0] == '*') {
+            any = allowed;
+        }
+        p = end;
+    }
+    // An explicit entry wins over the wildcard
+    return gzip >= 0 ? gzip == 1 : any == 1;
+}
+
+static bool request_accepts_gzip(httpd_req_t* req) {
+    char value[HTTP_CACHE_HDR_MAX];
+    size_t len = httpd_req_get_hdr_value_len(req, "Accept-Encoding");
+    if (len == 0) {
+        return true;  // no header: any coding will do
+    }
+    if (len >= sizeof(value) ||
+        httpd_req_get_hdr_value_str(req, "Accept-Encoding", value,
+                                    sizeof(value)) != ESP_OK) {
+        return true;  // only browsers send that much, and they take gzip
+    }
+    return http_cache_accepts_gzip(value);
+}
+
+esp_err_t http_cache_send_gzip(httpd_req_t* req, const char* type,
+                               const unsigned char* gz, size_t gz_size,
+                               const char* etag) {
+    // Browsers revalidate on every load and get a 304 while the firmware's
+    // page is unchanged.
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (http_cache_etag_matches(req, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    if (!request_accepts_gzip(req)) {
+        httpd_resp_set_status(req, "406 Not Acceptable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_sendstr(req,
+                                  "This page is only available gzip-encoded");
+    }
+
+    httpd_resp_set_type(req, type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char*)gz, gz_size);
+}
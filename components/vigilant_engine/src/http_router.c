@@ -0,0 +1,263 @@
+#include "http_router.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+static const char* TAG_ROUTER = "http_router";
+
+#define HTTP_ROUTER_MAX_ROUTES CONFIG_VE_HTTP_MAX_ENDPOINTS
+// Enough for routes of three segments that share nothing; routes with a
+// common prefix share its nodes
+#define HTTP_ROUTER_MAX_NODES (HTTP_ROUTER_MAX_ROUTES * 3 + 1)
+
+// One path segment. Children are a linked list with literal segments in
+// front of the parameter, so a single pass tries literals first. Indices
+// are 0 for "none": node 0 is the root and never a child, routes are 1-based.
+typedef struct {
+    const char* seg;  // into the registered pattern; NULL for "{name}"
+    uint8_t seg_len;
+    uint16_t child;
+    uint16_t sibling;
+    uint16_t routes;  // routes ending at this node, one per method
+} router_node_t;
+
+typedef struct {
+    void* route;
+    int method;  // httpd_method_t or HTTP_ANY
+    uint16_t next;
+} router_route_t;
+
+static SemaphoreHandle_t s_router_mutex = NULL;
+static router_node_t s_nodes[HTTP_ROUTER_MAX_NODES];
+static size_t s_node_count = 1;  // the root
+static router_route_t s_routes[HTTP_ROUTER_MAX_ROUTES];
+static size_t s_route_count = 0;
+
+// Next non-empty segment of a path that ends at '\0' or a query string.
+static bool next_segment(const char** path, const char** seg, size_t* len) {
+    const char* p = *path;
+    while (*p == '/') p++;
+    const char* end = p;
+    while (*end != '\0' && *end != '/' && *end != '?' && *end != '#') end++;
+    *path = end;
+    *seg = p;
+    *len = (size_t)(end - p);
+    return *len > 0;
+}
+
+static bool is_param(const char* seg, size_t len) {
+    return len > 2 && seg[0] == '{' && seg[len - 1] == '}';
+}
+
+static bool pattern_valid(const char* pattern) {
+    if (pattern[0] != '/') return false;
+
+    const char* p = pattern;
+    const char* seg;
+    size_t len;
+    size_t params = 0;
+    while (next_segment(&p, &seg, &len)) {
+        if (len > UINT8_MAX) return false;
+        // Braces only as a whole "{name}" segment
+        bool braces = memchr(seg, '{', len) || memchr(seg, '}', len);
+        if (braces && (!is_param(seg, len) ||
+                       memchr(seg + 1, '{', len - 2) ||
+                       memchr(seg + 1, '}', len - 2))) {
+            return false;
+        }
+        if (braces && ++params > HTTP_ROUTER_MAX_PARAMS) return false;
+    }
+    return *p == '\0';
+}
+
+static uint16_t find_child(uint16_t node, const char* seg, size_t len) {
+    bool param = is_param(seg, len);
+    for (uint16_t c = s_nodes[node].child; c; c = s_nodes[c].sibling) {
+        const router_node_t* n = &s_nodes[c];
+        if (param ? n->seg == NULL
+                  : n->seg && n->seg_len == len &&
+                        memcmp(n->seg, seg, len) == 0) {
+            return c;
+        }
+    }
+    return 0;
+}
+
+// http_router_add() has checked that there is room
+static uint16_t add_child(uint16_t node, const char* seg, size_t len) {
+    uint16_t c = (uint16_t)s_node_count++;
+    router_node_t* n = &s_nodes[c];
+    if (is_param(seg, len)) {
+        // Parameters go last, after every literal sibling
+        n->seg = NULL;
+        uint16_t* link = &s_nodes[node].child;
+        while (*link) link = &s_nodes[*link].sibling;
+        *link = c;
+    } else {
+        n->seg = seg;
+        n->seg_len = (uint8_t)len;
+        n->sibling = s_nodes[node].child;
+        s_nodes[node].child = c;
+    }
+    return c;
+}
+
+static SemaphoreHandle_t router_mutex(void) {
+    return __atomic_load_n(&s_router_mutex, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t http_router_init(void) {
+    if (router_mutex()) return ESP_OK;
+
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    if (!mutex) return ESP_ERR_NO_MEM;
+    // Endpoints may be registered from several tasks; one mutex wins
+    SemaphoreHandle_t expected = NULL;
+    if (!__atomic_compare_exchange_n(&s_router_mutex, &expected, mutex, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        vSemaphoreDelete(mutex);
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_router_add(const char* pattern, int method, void* route) {
+    if (!pattern || !route || !pattern_valid(pattern)) {
+        ESP_LOGE(TAG_ROUTER, "Invalid route pattern '%s'",
+                 pattern ? pattern : "(null)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    SemaphoreHandle_t mutex = router_mutex();
+    if (!mutex) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    // Everything is checked before the trie changes: nodes point into
+    // `pattern`, which the caller frees when the route is not added
+    uint16_t node = 0;
+    size_t missing = 0;  // segments that need a new node
+    const char* p = pattern;
+    const char* seg;
+    size_t len;
+    while (next_segment(&p, &seg, &len)) {
+        uint16_t child = missing ? 0 : find_child(node, seg, len);
+        if (child) {
+            node = child;
+        } else {
+            missing++;
+        }
+    }
+
+    if (s_route_count >= HTTP_ROUTER_MAX_ROUTES ||
+        s_node_count + missing > HTTP_ROUTER_MAX_NODES) {
+        err = ESP_ERR_NO_MEM;
+    } else if (missing == 0) {
+        for (uint16_t r = s_nodes[node].routes; r; r = s_routes[r - 1].next) {
+            if (s_routes[r - 1].method == method) {
+                err = ESP_ERR_INVALID_STATE;
+                break;
+            }
+        }
+    }
+    if (err == ESP_OK) {
+        node = 0;
+        p = pattern;
+        while (next_segment(&p, &seg, &len)) {
+            uint16_t child = find_child(node, seg, len);
+            node = child ? child : add_child(node, seg, len);
+        }
+        s_routes[s_route_count] = (router_route_t){
+            .route = route,
+            .method = method,
+            .next = s_nodes[node].routes,
+        };
+        s_nodes[node].routes = (uint16_t)++s_route_count;
+    }
+    xSemaphoreGive(mutex);
+
+    if (err == ESP_ERR_NO_MEM) {
+        ESP_LOGE(TAG_ROUTER,
+                 "No room for route %s, raise VE_HTTP_MAX_ENDPOINTS", pattern);
+    }
+    return err;
+}
+
+// Depth-first, so a literal segment that leads nowhere falls back to a
+// parameter at the same level. Recursion depth is bounded by the trie depth.
+static void* match_node(uint16_t node, const char* uri, const char* path,
+                        int method, bool* path_known,
+                        http_router_params_t* params) {
+    const char* seg;
+    size_t len;
+    if (!next_segment(&path, &seg, &len)) {
+        void* any = NULL;
+        for (uint16_t r = s_nodes[node].routes; r; r = s_routes[r - 1].next) {
+            const router_route_t* route = &s_routes[r - 1];
+            *path_known = true;
+            if (route->method == method) return route->route;
+            if (route->method == HTTP_ANY) any = route->route;
+        }
+        return any;
+    }
+
+    for (uint16_t c = s_nodes[node].child; c; c = s_nodes[c].sibling) {
+        const router_node_t* n = &s_nodes[c];
+        if (n->seg) {
+            if (n->seg_len != len || memcmp(n->seg, seg, len) != 0) continue;
+            void* route = match_node(c, uri, path, method, path_known, params);
+            if (route) return route;
+            continue;
+        }
+        // pattern_valid() caps the parameters on any path through the trie
+        params->values[params->count].offset = (uint16_t)(seg - uri);
+        params->values[params->count].len = (uint16_t)len;
+        params->count++;
+        void* route = match_node(c, uri, path, method, path_known, params);
+        if (route) return route;
+        params->count--;
+    }
+    return NULL;
+}
+
+void* http_router_match(const char* uri, int method, bool* path_known,
+                        http_router_params_t* params) {
+    bool known = false;
+    http_router_params_t unused;
+    if (!params) params = &unused;
+    params->count = 0;
+
+    void* route = NULL;
+    SemaphoreHandle_t mutex = router_mutex();
+    if (mutex) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        route = match_node(0, uri, uri, method, &known, params);
+        xSemaphoreGive(mutex);
+    }
+    if (path_known) *path_known = known;
+    return route;
+}
+
+bool http_router_param(const char* pattern, const http_router_params_t* params,
+                       const char* uri, const char* name, const char** value,
+                       size_t* value_len) {
+    size_t name_len = strlen(name);
+    const char* p = pattern;
+    const char* seg;
+    size_t len;
+    size_t index = 0;
+    while (next_segment(&p, &seg, &len)) {
+        if (!is_param(seg, len)) continue;
+        if (index >= params->count) return false;
+        if (len == name_len + 2 && memcmp(seg + 1, name, name_len) == 0) {
+            *value = uri + params->values[index].offset;
+            *value_len = params->values[index].len;
+            return true;
+        }
+        index++;
+    }
+    return false;
+}
@@ -14,10 +14,24 @@
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 #include "esp_tls_crypto.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "http_async.h"
+#include "http_cache.h"
+#include "http_router.h"
+#include "i2c_bench.h"
+#include "info_snapshot.h"
+#include "json_writer.h"
+#include "latency_hist.h"
+#include "log_bench.h"
+#include "log_store.h"
+#include "metrics.h"
 #include "nvs_flash.h"
 #include "ota_http.h"
 #include "sdkconfig.h"
+#include "sensors.h"
 #include "soc/soc_caps.h"
 #include "vigilant.h"
 #include "websocket.h"
@@ -33,6 +47,430 @@ static httpd_handle_t s_server = NULL;  // unser globaler Server-Handle
 #define VE_HTTPD_MAX_OPEN_SOCKETS 7
 #endif
 
+// Request statistics per registered URI and router endpoint. Handlers
+// registered through http_server_register_uri() run via http_uri_dispatch(),
+// which counts them; endpoints get there through http_router_dispatch().
+#define HTTP_URI_STATS_MAX (32 + CONFIG_VE_HTTP_MAX_ENDPOINTS)
+
+typedef struct {
+    httpd_uri_t uri;  // registered copy, routed to http_uri_dispatch()
+    esp_err_t (*handler)(httpd_req_t* req);
+    void* user_ctx;
+    bool async;   // runs on an http_async worker
+    bool routed;  // an endpoint matched by http_router, not by httpd
+    metrics_counter_t requests;
+    metrics_counter_t errors;
+#if CONFIG_VE_HTTP_LATENCY_STATS
+    latency_hist_t latency;
+#endif
+} http_uri_stats_t;
+
+// Entries are never removed, so a URI registered again keeps its counters.
+// Registration happens during startup and from the httpd task, endpoints
+// also from application tasks, so slots are claimed under the mutex; an
+// entry is filled in before it is counted, and readers need no lock.
+static http_uri_stats_t s_uri_stats[HTTP_URI_STATS_MAX];
+static size_t s_uri_stats_count = 0;
+static SemaphoreHandle_t s_uri_stats_mutex = NULL;
+
+// The endpoint a routed request matched and where its path parameters are,
+// so http_server_endpoint_param() need not match the URI again
+typedef struct {
+    const httpd_req_t* req;
+    http_uri_stats_t* stats;
+    http_router_params_t params;
+} http_route_t;
+
+// Route of the request whose handler runs on this task: the httpd task or
+// the async worker that took it over
+static _Thread_local const http_route_t* t_route = NULL;
+
+static void uri_decode(char* dest, const char* src, size_t len);
+esp_err_t http_404_error_handler(httpd_req_t* req, httpd_err_code_t err);
+
+static size_t uri_stats_count(void) {
+    return __atomic_load_n(&s_uri_stats_count, __ATOMIC_ACQUIRE);
+}
+
+// Creates the stats mutex and the router. Endpoints can be registered before
+// vigilant_init() starts the server, from any task, so whichever
+// registration comes first does this.
+static esp_err_t http_server_init(void) {
+    if (!__atomic_load_n(&s_uri_stats_mutex, __ATOMIC_ACQUIRE)) {
+        SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+        if (!mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+        SemaphoreHandle_t expected = NULL;
+        if (!__atomic_compare_exchange_n(&s_uri_stats_mutex, &expected,
+                                         mutex, false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            vSemaphoreDelete(mutex);
+        }
+    }
+    return http_router_init();
+}
+
+static void http_uri_finish(http_uri_stats_t* stats, esp_err_t ret,
+                            int64_t start) {
+    if (ret != ESP_OK) {
+        metrics_counter_inc(&stats->errors);
+    }
+#if CONFIG_VE_HTTP_LATENCY_STATS
+    int64_t elapsed = esp_timer_get_time() - start;
+    latency_hist_record(&stats->latency,
+                   elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+#else
+    (void)start;
+#endif
+}
+
+static int64_t http_uri_start_time(void) {
+#if CONFIG_VE_HTTP_LATENCY_STATS
+    return esp_timer_get_time();
+#else
+    return 0;
+#endif
+}
+
+static esp_err_t http_uri_run(http_uri_stats_t* stats, httpd_req_t* req,
+                              int64_t start) {
+    req->user_ctx = stats->user_ctx;
+    esp_err_t ret = stats->handler(req);
+    http_uri_finish(stats, ret, start);
+    return ret;
+}
+
+// Worker side of an offloaded request; the latency includes the queue wait.
+static esp_err_t http_uri_run_async(httpd_req_t* req, void* ctx,
+                                    int64_t accepted_at) {
+    return http_uri_run((http_uri_stats_t*)ctx, req, accepted_at);
+}
+
+static esp_err_t http_uri_dispatch(httpd_req_t* req) {
+    http_uri_stats_t* stats = (http_uri_stats_t*)req->user_ctx;
+    metrics_counter_inc(&stats->requests);
+
+    if (stats->async &&
+        http_async_submit(req, http_uri_run_async, stats, NULL) == ESP_OK) {
+        return ESP_OK;
+    }
+    return http_uri_run(stats, req, http_uri_start_time());
+}
+
+static esp_err_t register_uri(httpd_handle_t server, const httpd_uri_t* uri,
+                              bool async) {
+    if (http_server_init() != ESP_OK) {
+        ESP_LOGW(TAG, "No stats for %s", uri->uri);
+        return httpd_register_uri_handler(server, uri);
+    }
+
+    xSemaphoreTake(s_uri_stats_mutex, portMAX_DELAY);
+    http_uri_stats_t* stats = NULL;
+    size_t count = s_uri_stats_count;
+    for (size_t i = 0; i < count && !stats; ++i) {
+        if (!s_uri_stats[i].routed &&
+            s_uri_stats[i].uri.method == uri->method &&
+            strcmp(s_uri_stats[i].uri.uri, uri->uri) == 0) {
+            stats = &s_uri_stats[i];
+        }
+    }
+    bool claimed = !stats && count < HTTP_URI_STATS_MAX;
+    if (claimed) {
+        stats = &s_uri_stats[count];
+    }
+    if (stats) {
+        stats->handler = uri->handler;
+        stats->user_ctx = uri->user_ctx;
+        stats->async = async;
+        stats->uri = *uri;
+        stats->uri.handler = http_uri_dispatch;
+        stats->uri.user_ctx = stats;
+    }
+    if (claimed) {
+        __atomic_store_n(&s_uri_stats_count, count + 1, __ATOMIC_RELEASE);
+    }
+    xSemaphoreGive(s_uri_stats_mutex);
+
+    if (!stats) {
+        ESP_LOGW(TAG, "No stats slot left for %s", uri->uri);
+        return httpd_register_uri_handler(server, uri);
+    }
+    return httpd_register_uri_handler(server, &stats->uri);
+}
+
+esp_err_t http_server_register_uri(httpd_handle_t server,
+                                   const httpd_uri_t* uri) {
+    return register_uri(server, uri, false);
+}
+
+esp_err_t http_server_register_async_uri(httpd_handle_t server,
+                                         const httpd_uri_t* uri) {
+    return register_uri(server, uri, true);
+}
+
+// Worker side of an offloaded endpoint; `req` is the worker's copy.
+static esp_err_t http_route_run_async(httpd_req_t* req, void* ctx,
+                                      int64_t accepted_at) {
+    http_route_t* route = (http_route_t*)ctx;
+    route->req = req;
+    t_route = route;
+    esp_err_t ret = http_uri_run(route->stats, req, accepted_at);
+    t_route = NULL;
+    return ret;
+}
+
+// The catch-all httpd handler for one method. httpd tries handlers in
+// registration order, so these must come after every exact URI.
+static esp_err_t http_router_dispatch(httpd_req_t* req) {
+    bool path_known = false;
+    http_route_t route = {.req = req};
+    route.stats =
+        http_router_match(req->uri, req->method, &path_known, &route.params);
+    if (!route.stats) {
+        // Answered like httpd would, but the connection stays open
+        if (path_known) {
+            httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED,
+                                "Request method for this URI is not handled");
+        } else {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND,
+                                "This URI does not exist");
+        }
+        return ESP_OK;
+    }
+
+    metrics_counter_inc(&route.stats->requests);
+    if (route.stats->async) {
+        // The worker runs the handler after this returns
+        http_route_t* copy = malloc(sizeof(*copy));
+        if (copy) {
+            *copy = route;
+            if (http_async_submit(req, http_route_run_async, copy, free) ==
+                ESP_OK) {
+                return ESP_OK;
+            }
+            free(copy);
+        }
+    }
+
+    t_route = &route;
+    esp_err_t ret = http_uri_run(route.stats, req, http_uri_start_time());
+    t_route = NULL;
+    return ret;
+}
+
+static void register_router_method(httpd_handle_t server,
+                                   httpd_method_t method) {
+    const httpd_uri_t catch_all = {
+        .uri = "/*",
+        .method = method,
+        .handler = http_router_dispatch,
+        .user_ctx = NULL,
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &catch_all);
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_HANDLER_EXISTS) {
+        ESP_LOGE(TAG, "Failed to register router for %s: %s",
+                 catch_all.method == HTTP_ANY
+                     ? "ANY"
+                     : http_method_str(catch_all.method),
+                 esp_err_to_name(err));
+    }
+}
+
+// One httpd handler per method that has endpoints, however many there are
+static void register_router_handlers(httpd_handle_t server) {
+    size_t count = uri_stats_count();
+    for (size_t i = 0; i < count; ++i) {
+        if (s_uri_stats[i].routed) {
+            register_router_method(server, s_uri_stats[i].uri.method);
+        }
+    }
+}
+
+esp_err_t http_server_register_endpoint(const httpd_uri_t* uri, bool async) {
+    if (!uri || !uri->uri || !uri->handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (uri->is_websocket) {
+        // httpd has to see the websocket handshake itself
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_err_t err = http_server_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Application patterns may live on the caller's stack
+    char* pattern = strdup(uri->uri);
+    if (!pattern) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(s_uri_stats_mutex, portMAX_DELAY);
+    size_t count = s_uri_stats_count;
+    if (count >= HTTP_URI_STATS_MAX) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        http_uri_stats_t* stats = &s_uri_stats[count];
+        memset(stats, 0, sizeof(*stats));
+        stats->handler = uri->handler;
+        stats->user_ctx = uri->user_ctx;
+        stats->async = async;
+        stats->routed = true;
+        stats->uri = *uri;
+        stats->uri.uri = pattern;
+
+        // Rejects a pattern and method that are registered already
+        err = http_router_add(pattern, uri->method, stats);
+        if (err == ESP_OK) {
+            __atomic_store_n(&s_uri_stats_count, count + 1,
+                             __ATOMIC_RELEASE);
+        }
+    }
+    xSemaphoreGive(s_uri_stats_mutex);
+
+    if (err != ESP_OK) {
+        if (count >= HTTP_URI_STATS_MAX) {
+            ESP_LOGE(TAG, "No stats slot left for endpoint %s", pattern);
+        }
+        free(pattern);
+        return err;
+    }
+
+    if (s_server) {
+        register_router_method(s_server, uri->method);
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_server_endpoint_param(httpd_req_t* req, const char* name,
+                                     char* value, size_t size) {
+    if (!req || !name || !value || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Matched once in http_router_dispatch(), set while the handler runs
+    const http_route_t* route = t_route;
+    const char* raw;
+    size_t raw_len;
+    if (!route || route->req != req ||
+        !http_router_param(route->stats->uri.uri, &route->params, req->uri,
+                           name, &raw, &raw_len)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Decoding only shrinks the value, so this is the worst case
+    if (raw_len >= size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uri_decode(value, raw, raw_len);
+    return ESP_OK;
+}
+
+static const char* uri_method_name(const http_uri_stats_t* stats) {
+    return stats->uri.method == HTTP_ANY ? "ANY"
+                                         : http_method_str(stats->uri.method);
+}
+
+// Returns false if the labels do not fit into `buf`. The URI's samples are
+// then left out rather than written with a cut-off label.
+static bool uri_stats_labels(const http_uri_stats_t* stats, char* buf,
+                             size_t size) {
+    static const char prefix[] = "uri=\"";
+    if (size <= sizeof(prefix)) return false;
+    memcpy(buf, prefix, sizeof(prefix));
+    size_t len = sizeof(prefix) - 1;
+    len += metrics_escape_label(buf + len, size - len, stats->uri.uri);
+    if (len >= size) {
+        ESP_LOGD(TAG, "metrics labels too long for %s", stats->uri.uri);
+        return false;
+    }
+    int n = snprintf(buf + len, size - len, "\",method=\"%s\"",
+                     uri_method_name(stats));
+    return n >= 0 && (size_t)n < size - len;
+}
+
+void http_server_write_metrics(metrics_out_t* out) {
+    size_t count = uri_stats_count();
+    char labels[160];
+
+    metrics_family(out, "ve_http_requests_total", "counter",
+                   "Requests (websocket: frames) handled per URI");
+    for (size_t i = 0; i < count; ++i) {
+        const http_uri_stats_t* stats = &s_uri_stats[i];
+        if (!uri_stats_labels(stats, labels, sizeof(labels))) continue;
+        metrics_sample(out, "ve_http_requests_total", labels,
+                       metrics_counter_read(&stats->requests));
+    }
+
+    metrics_family(out, "ve_http_errors_total", "counter",
+                   "Handler calls that returned an error, per URI");
+    for (size_t i = 0; i < count; ++i) {
+        const http_uri_stats_t* stats = &s_uri_stats[i];
+        if (!uri_stats_labels(stats, labels, sizeof(labels))) continue;
+        metrics_sample(out, "ve_http_errors_total", labels,
+                       metrics_counter_read(&stats->errors));
+    }
+
+#if CONFIG_VE_HTTP_LATENCY_STATS
+    metrics_family(out, "ve_http_request_duration_us", "histogram",
+                   "Handler latency per URI");
+    for (size_t i = 0; i < count; ++i) {
+        const latency_hist_t* h = &s_uri_stats[i].latency;
+        if (latency_hist_count(h) == 0 ||
+            !uri_stats_labels(&s_uri_stats[i], labels, sizeof(labels))) {
+            continue;
+        }
+
+        // Buckets are cumulative; the last one is +Inf and equals _count.
+        // Room for `labels` plus ",le=\"4294967295\"".
+        char le_labels[sizeof(labels) + 20];
+        uint32_t total = 0;
+        for (size_t b = 0; b < LATENCY_HIST_BUCKETS; ++b) {
+            total += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+            if (b < LATENCY_HIST_BUCKETS - 1) {
+                snprintf(le_labels, sizeof(le_labels), "%s,le=\"%" PRIu32 "\"",
+                         labels, latency_hist_bucket_bound(b));
+            } else {
+                snprintf(le_labels, sizeof(le_labels), "%s,le=\"+Inf\"",
+                         labels);
+            }
+            metrics_sample(out, "ve_http_request_duration_us_bucket",
+                           le_labels, total);
+        }
+        metrics_sample(out, "ve_http_request_duration_us_sum", labels,
+                       __atomic_load_n(&h->sum_us, __ATOMIC_RELAXED));
+        metrics_sample(out, "ve_http_request_duration_us_count", labels,
+                       total);
+    }
+
+    metrics_family(out, "ve_http_request_duration_max_us", "gauge",
+                   "Slowest handler run per URI");
+    for (size_t i = 0; i < count; ++i) {
+        const latency_hist_t* h = &s_uri_stats[i].latency;
+        if (latency_hist_count(h) == 0 ||
+            !uri_stats_labels(&s_uri_stats[i], labels, sizeof(labels))) {
+            continue;
+        }
+        metrics_sample(out, "ve_http_request_duration_max_us", labels,
+                       __atomic_load_n(&h->max_us, __ATOMIC_RELAXED));
+    }
+#endif
+
+    http_async_write_metrics(out);
+
+    // httpd does not tie sockets to URIs; websocket sockets are in ve_ws_*
+    size_t open = 0;
+    if (s_server) {
+        int fds[VE_HTTPD_MAX_OPEN_SOCKETS];
+        open = VE_HTTPD_MAX_OPEN_SOCKETS;
+        if (httpd_get_client_list(s_server, &open, fds) != ESP_OK) {
+            open = 0;
+        }
+    }
+    metrics_family(out, "ve_http_open_sockets", "gauge",
+                   "Sockets currently open on the HTTP server");
+    metrics_sample(out, "ve_http_open_sockets", NULL, open);
+}
+
 static int hex_nibble(char c) {
     if (c >= '0' && c <= '9') {
         return c - '0';
@@ -70,10 +508,19 @@ static void uri_decode(char* dest, const char* src, size_t len) {
     dest[wr] = '\0';
 }
 
+// Switched by /ctrl. The URIs stay registered: one registered again while
+// the server runs takes the first free handler slot, which can be behind the
+// router's catch-alls, and would never be reached. Only the httpd task uses it.
+static bool s_hello_echo_enabled = true;
+
 static esp_err_t hello_get_handler(httpd_req_t* req) {
     char* buf;
     size_t buf_len;
 
+    if (!s_hello_echo_enabled) {
+        return http_404_error_handler(req, HTTPD_404_NOT_FOUND);
+    }
+
     buf_len = httpd_req_get_hdr_value_len(req, "Host") + 1;
     if (buf_len > 1) {
         buf = malloc(buf_len);
@@ -161,6 +608,10 @@ static esp_err_t echo_post_handler(httpd_req_t* req) {
     char buf[100];
     int ret, remaining = req->content_len;
 
+    if (!s_hello_echo_enabled) {
+        return http_404_error_handler(req, HTTPD_404_NOT_FOUND);
+    }
+
     while (remaining > 0) {
         if ((ret = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)))) <=
             0) {
@@ -199,32 +650,70 @@ static const httpd_uri_t any = {.uri = "/any",
                                 .handler = any_handler,
                                 .user_ctx = "Hello World!"};
 
+#if CONFIG_VE_HTTP_LATENCY_STATS
+static esp_err_t latency_get_handler(httpd_req_t* req) {
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    char buf[JSON_WRITER_HTTP_BUF];
+    json_writer_t w;
+    json_writer_init_httpd(&w, req, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_key(&w, "uris");
+    json_writer_array_begin(&w);
+    size_t count = uri_stats_count();
+    for (size_t i = 0; i < count; ++i) {
+        const http_uri_stats_t* stats = &s_uri_stats[i];
+        const latency_hist_t* h = &stats->latency;
+        uint32_t total = latency_hist_count(h);
+
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "uri", stats->uri.uri);
+        json_writer_kv_string(&w, "method", uri_method_name(stats));
+        json_writer_kv_uint(&w, "count", total);
+        json_writer_kv_uint(&w, "p50_us",
+                            latency_hist_percentile(h, total, 50));
+        json_writer_kv_uint(&w, "p90_us",
+                            latency_hist_percentile(h, total, 90));
+        json_writer_kv_uint(&w, "p99_us",
+                            latency_hist_percentile(h, total, 99));
+        json_writer_kv_uint(&w, "max_us",
+                            __atomic_load_n(&h->max_us, __ATOMIC_RELAXED));
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    return json_writer_finish(&w);
+}
+
+static const httpd_uri_t latency_uri = {
+    .uri = "/latency",
+    .method = HTTP_GET,
+    .handler = latency_get_handler,
+    .user_ctx = NULL,
+};
+#endif
+
 static esp_err_t info_get_handler(httpd_req_t* req) {
-    VigilantInfo info = {0};
-    esp_err_t err = vigilant_get_info(&info);
+    char body[INFO_SNAPSHOT_MAX];
+    char etag[INFO_SNAPSHOT_ETAG_MAX];
+    esp_err_t err = info_snapshot_get(body, sizeof(body), etag, sizeof(etag));
     if (err != ESP_OK) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
                             "Failed to fetch info");
         return err;
     }
 
-    httpd_resp_set_type(req, "application/json");
-    char payload[256];
-    int written = snprintf(
-        payload, sizeof(payload),
-        "{\"name\":\"%s\",\"network_mode\":%d,\"mac\":\"%s\",\"ap_ssid\":\"%"
-        "s\",\"sta_ssid\":\"%s\",\"ip_sta\":\"%s\",\"ip_ap\":\"%s\"}",
-        info.unique_component_name, (int)info.network_mode, info.mac,
-        info.ap_ssid, info.sta_ssid, info.ip_sta, info.ip_ap);
-
-    if (written < 0 || written >= (int)sizeof(payload)) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                            "Info too large");
-        return ESP_FAIL;
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if (http_cache_etag_matches(req, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
     }
 
-    httpd_resp_send(req, payload, written);
-    return ESP_OK;
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, body, HTTPD_RESP_USE_STRLEN);
 }
 
 static const httpd_uri_t info_uri = {
@@ -244,101 +733,53 @@ static esp_err_t i2cinfo_get_handler(httpd_req_t* req) {
     }
 
     httpd_resp_set_type(req, "application/json");
-    size_t payload_capacity =
-        256  // Calculates a size for the json object, for malloc later
-        + ((size_t)info.added_device_count *
-           160)  // Added devices contain more information in the json than
-                 // detected devices.
-        + ((size_t)info.detected_device_count * 96);
-    char* payload = malloc(payload_capacity);
-    if (!payload) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                            "No memory for i2c info");
-        return ESP_ERR_NO_MEM;
-    }
-
-    size_t offset = 0;
-    int written = snprintf(
-        payload + offset, payload_capacity - offset,
-        "{\"enabled\":%s,\"sda_io\":%u,\"scl_io\":%u,\"frequency_hz\":%" PRIu32
-        ",\"added_device_count\":%u,\"detected_device_count\":%u,\"added_"
-        "devices\":[",
-        info.enabled ? "true" : "false", (unsigned int)info.sda_io,
-        (unsigned int)info.scl_io, info.frequency_hz,
-        (unsigned int)info.added_device_count,
-        (unsigned int)info.detected_device_count);
-
-    if (written < 0 || written >= (int)(payload_capacity - offset)) {
-        free(payload);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                            "Info too large");
-        return ESP_FAIL;
-    }
-    offset += (size_t)written;
-
+    char buf[JSON_WRITER_HTTP_BUF];
+    json_writer_t w;
+    json_writer_init_httpd(&w, req, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_kv_bool(&w, "enabled", info.enabled);
+    json_writer_kv_uint(&w, "sda_io", info.sda_io);
+    json_writer_kv_uint(&w, "scl_io", info.scl_io);
+    json_writer_kv_uint(&w, "frequency_hz", info.frequency_hz);
+    json_writer_kv_uint(&w, "added_device_count", info.added_device_count);
+    json_writer_kv_uint(&w, "detected_device_count",
+                        info.detected_device_count);
+
+    json_writer_key(&w, "added_devices");
+    json_writer_array_begin(&w);
     for (uint8_t i = 0; i < info.added_device_count; ++i) {
         const VigilantI2CDevice* device = &info.added_devices[i];
-        written = snprintf(
-            payload + offset, payload_capacity - offset,
-            "%s{\"name\":\"I2C Device "
-            "0x%02X\",\"address\":%u,\"address_hex\":\"0x%02X\",\"whoami_reg\":"
-            "%u,\"whoami_reg_hex\":\"0x%02X\",\"expected_whoami\":%u,"
-            "\"expected_whoami_hex\":\"0x%02X\"}",
-            i == 0 ? "" : ",", (unsigned int)device->address,
-            (unsigned int)device->address, (unsigned int)device->address,
-            (unsigned int)device->whoami_reg, (unsigned int)device->whoami_reg,
-            (unsigned int)device->expected_whoami,
-            (unsigned int)device->expected_whoami);
-
-        if (written < 0 || written >= (int)(payload_capacity - offset)) {
-            free(payload);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                                "Info too large");
-            return ESP_FAIL;
-        }
-        offset += (size_t)written;
-    }
-
-    written = snprintf(payload + offset, payload_capacity - offset,
-                       "],\"detected_devices\":[");
-    if (written < 0 || written >= (int)(payload_capacity - offset)) {
-        free(payload);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                            "Info too large");
-        return ESP_FAIL;
+        json_writer_object_begin(&w);
+        json_writer_key(&w, "name");
+        json_writer_stringf(&w, "I2C Device 0x%02X", device->address);
+        json_writer_kv_uint(&w, "address", device->address);
+        json_writer_key(&w, "address_hex");
+        json_writer_stringf(&w, "0x%02X", device->address);
+        json_writer_kv_uint(&w, "whoami_reg", device->whoami_reg);
+        json_writer_key(&w, "whoami_reg_hex");
+        json_writer_stringf(&w, "0x%02X", device->whoami_reg);
+        json_writer_kv_uint(&w, "expected_whoami", device->expected_whoami);
+        json_writer_key(&w, "expected_whoami_hex");
+        json_writer_stringf(&w, "0x%02X", device->expected_whoami);
+        json_writer_object_end(&w);
     }
-    offset += (size_t)written;
+    json_writer_array_end(&w);
 
+    json_writer_key(&w, "detected_devices");
+    json_writer_array_begin(&w);
     for (uint8_t i = 0; i < info.detected_device_count; ++i) {
         uint8_t address = info.detected_devices[i];
-        written =
-            snprintf(payload + offset, payload_capacity - offset,
-                     "%s{\"name\":\"Detected I2C Device "
-                     "0x%02X\",\"address\":%u,\"address_hex\":\"0x%02X\"}",
-                     i == 0 ? "" : ",", (unsigned int)address,
-                     (unsigned int)address, (unsigned int)address);
-
-        if (written < 0 || written >= (int)(payload_capacity - offset)) {
-            free(payload);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                                "Info too large");
-            return ESP_FAIL;
-        }
-        offset += (size_t)written;
+        json_writer_object_begin(&w);
+        json_writer_key(&w, "name");
+        json_writer_stringf(&w, "Detected I2C Device 0x%02X", address);
+        json_writer_kv_uint(&w, "address", address);
+        json_writer_key(&w, "address_hex");
+        json_writer_stringf(&w, "0x%02X", address);
+        json_writer_object_end(&w);
     }
-
-    written = snprintf(payload + offset, payload_capacity - offset, "]}");
-    if (written < 0 || written >= (int)(payload_capacity - offset)) {
-        free(payload);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
-                            "Info too large");
-        return ESP_FAIL;
-    }
-    offset += (size_t)written;
-
-    httpd_resp_send(req, payload, (ssize_t)offset);
-    free(payload);
-    return ESP_OK;
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    return json_writer_finish(&w);
 }
 
 static const httpd_uri_t i2cinfo_uri = {
@@ -374,15 +815,13 @@ static esp_err_t ctrl_put_handler(httpd_req_t* req) {
     }
 
     if (buf == '0') {
-        ESP_LOGI(TAG, "Unregistering /hello and /echo URIs");
-        httpd_unregister_uri(req->handle, "/hello");
-        httpd_unregister_uri(req->handle, "/echo");
+        ESP_LOGI(TAG, "Disabling /hello and /echo URIs");
+        s_hello_echo_enabled = false;
         httpd_register_err_handler(req->handle, HTTPD_404_NOT_FOUND,
                                    http_404_error_handler);
     } else {
-        ESP_LOGI(TAG, "Registering /hello and /echo URIs");
-        httpd_register_uri_handler(req->handle, &hello);
-        httpd_register_uri_handler(req->handle, &echo);
+        ESP_LOGI(TAG, "Enabling /hello and /echo URIs");
+        s_hello_echo_enabled = true;
         httpd_register_err_handler(req->handle, HTTPD_404_NOT_FOUND, NULL);
     }
 
@@ -406,6 +845,9 @@ static httpd_handle_t start_webserver_internal(void) {
     config.max_uri_handlers =
         32;  // Fixes issue #28: ota_http: Failed to register Vigilant Dashboard
              // GET handler (ESP_ERR_HTTPD_HANDLERS_FULL)
+    // For the router's "/*" handlers; URIs without '*' still match exactly.
+    // Application endpoints go through the router and need no slot here.
+    config.uri_match_fn = httpd_uri_match_wildcard;
     config.max_open_sockets = VE_HTTPD_MAX_OPEN_SOCKETS;
     config.backlog_conn = 8;
     config.lru_purge_enable = true;
@@ -418,18 +860,42 @@ static httpd_handle_t start_webserver_internal(void) {
     ESP_LOGI(TAG, "Starting server on port: '%d' with %d open sockets",
              config.server_port, config.max_open_sockets);
     if (httpd_start(&server, &config) == ESP_OK) {
+        // Handlers registered as async fall back to running inline if the
+        // pool cannot start
+        (void)http_async_start();
+
         ESP_LOGI(TAG, "Registering URI handlers");
-        httpd_register_uri_handler(server, &hello);
-        httpd_register_uri_handler(server, &echo);
-        httpd_register_uri_handler(server, &ctrl);
-        httpd_register_uri_handler(server, &any);
-        httpd_register_uri_handler(server, &info_uri);
-        httpd_register_uri_handler(server, &i2cinfo_uri);
+        http_server_register_uri(server, &hello);
+        http_server_register_uri(server, &echo);
+        http_server_register_uri(server, &ctrl);
+        http_server_register_uri(server, &any);
+        http_server_register_uri(server, &info_uri);
+        http_server_register_uri(server, &i2cinfo_uri);
+#if CONFIG_VE_HTTP_LATENCY_STATS
+        http_server_register_uri(server, &latency_uri);
+#endif
+        metrics_register_handlers(server);
         websocket_register_handlers(server);
 
         // OTA-Handler registrieren
         ota_http_register_handlers(server);
 
+#if CONFIG_VE_LOG_FLASH
+        log_store_register_handlers(server);
+#endif
+#if CONFIG_VE_ENABLE_I2C
+        sensors_register_handlers(server);
+#endif
+#if CONFIG_VE_I2C_BENCHMARK
+        i2c_bench_register_handlers(server);
+#endif
+#if CONFIG_VE_LOG_BENCHMARK
+        log_bench_register_handlers(server);
+#endif
+
+        // Last, so every exact URI above is tried first
+        register_router_handlers(server);
+
         return server;
     }
 
@@ -438,6 +904,10 @@ static httpd_handle_t start_webserver_internal(void) {
 }
 
 esp_err_t http_server_start(void) {
+    esp_err_t err = http_server_init();
+    if (err != ESP_OK) {
+        return err;
+    }
     if (s_server == NULL) {
         s_server = start_webserver_internal();
         if (s_server == NULL) {
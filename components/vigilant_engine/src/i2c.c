@@ -1,5 +1,6 @@
 #include "i2c.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -7,103 +8,245 @@
 #include "driver/i2c_master.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "i2c_async.h"
+#include "json_writer.h"
+#include "metrics.h"
 #include "sdkconfig.h"
+#include "sensors.h"
+#include "websocket.h"
 
 #define I2C_SCL_IO CONFIG_VE_I2C_SCL_IO
 #define I2C_SDA_IO CONFIG_VE_I2C_SDA_IO
 #define I2C_PORT I2C_NUM_0
 #define I2C_FREQ_HZ CONFIG_VE_I2C_FREQ_HZ
 #define I2C_TIMEOUT_MS 100
+// 7-bit addresses outside the reserved ranges
+#define I2C_SCAN_FIRST 0x03
+#define I2C_SCAN_LAST 0x77
+#define I2C_DETECTED_MAX 16
+#define I2C_SCAN_TASK_STACK 3072
+// Added and removed addresses are disjoint, so at worst each of the 117
+// appears once: 363 characters with the commas, and 57 for the rest
+#define I2C_SCAN_MSG_MAX 512
 
 static const char* TAG = "ve_i2c";
 static i2c_master_bus_handle_t s_i2c_bus = NULL;
-static uint8_t s_detected_i2c_addresses[16] = {0};
+// Held for each engine transfer and for a whole transaction list, so a list
+// runs without other engine transfers in between. The background scan takes
+// it for one probe at a time.
+static SemaphoreHandle_t s_bus_mutex = NULL;
+
+// Result of the last complete scan pass, served by /i2cinfo without touching
+// the bus. Guarded by s_detected_mutex.
+static SemaphoreHandle_t s_detected_mutex = NULL;
+static uint8_t s_detected_i2c_addresses[I2C_DETECTED_MAX] = {0};
 static size_t s_detected_i2c_count = 0;
-
-static esp_err_t i2c_scan_devices(uint8_t* addresses, size_t max_addresses,
-                                  size_t* count, bool log_results) {
-    if (!s_i2c_bus) {
-        return ESP_ERR_INVALID_STATE;
-    }
-    if (!count) {
-        return ESP_ERR_INVALID_ARG;
+static uint32_t s_detected_set[4];  // one bit per address
+static TaskHandle_t s_scan_task = NULL;
+static metrics_counter_t s_scan_passes;
+
+// Bus statistics per device address for /metrics. A slot is claimed when the
+// device is added and kept after it is removed.
+#define I2C_STATS_MAX_DEVICES 16
+
+typedef struct {
+    uint16_t address;  // 0 while the slot is free
+    metrics_counter_t transactions;
+    metrics_counter_t nacks;
+    metrics_counter_t timeouts;
+    metrics_counter_t bytes;
+    metrics_counter_t cache_hits;    // transfers the register cache saved
+    metrics_counter_t cache_misses;  // cacheable transfers that used the bus
+} i2c_dev_stats_t;
+
+static i2c_dev_stats_t s_dev_stats[I2C_STATS_MAX_DEVICES];
+
+static i2c_dev_stats_t* i2c_dev_stats(uint16_t address, bool claim) {
+    for (int i = 0; i < I2C_STATS_MAX_DEVICES; ++i) {
+        uint16_t current = __atomic_load_n(&s_dev_stats[i].address,
+                                           __ATOMIC_ACQUIRE);
+        if (current == address) {
+            return &s_dev_stats[i];
+        }
+        if (current == 0 && claim) {
+            uint16_t expected = 0;
+            if (__atomic_compare_exchange_n(&s_dev_stats[i].address,
+                                            &expected, address, false,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE) ||
+                expected == address) {
+                return &s_dev_stats[i];
+            }
+        }
     }
+    return NULL;
+}
 
-    char line[128];
-    size_t found = 0;
-    size_t stored = 0;
+// The master driver reports a NACK as ESP_ERR_INVALID_STATE, newer
+// releases as ESP_ERR_INVALID_RESPONSE.
+static void i2c_record(const VigilantI2CDevice* device, esp_err_t err,
+                       size_t bytes) {
+    i2c_dev_stats_t* stats = i2c_dev_stats(device->address, false);
+    if (!stats) return;
 
-    if (log_results) {
-        ESP_LOGI(TAG, "I2C bus scan on SDA=%d SCL=%d", I2C_SDA_IO, I2C_SCL_IO);
+    metrics_counter_inc(&stats->transactions);
+    if (err == ESP_OK) {
+        metrics_counter_add(&stats->bytes, (uint32_t)bytes);
+    } else if (err == ESP_ERR_TIMEOUT) {
+        metrics_counter_inc(&stats->timeouts);
+    } else if (err == ESP_ERR_INVALID_STATE ||
+               err == ESP_ERR_INVALID_RESPONSE) {
+        metrics_counter_inc(&stats->nacks);
+    }
+}
 
-        strcpy(line, "    ");
-        for (int i = 0; i < 16; i++) {
-            char tmp[4];
-            snprintf(tmp, sizeof(tmp), "%02X ", i);
-            strncat(line, tmp, sizeof(line) - strlen(line) - 1);
-        }
-        ESP_LOGI(TAG, "%s", line);
+static bool addr_set_has(const uint32_t* set, uint8_t addr) {
+    return set[addr / 32] & (1u << (addr % 32));
+}
+
+// Logs the result of the first scan as an address table.
+static void i2c_log_scan(const uint32_t* found) {
+    char line[128];
+    size_t count = 0;
+
+    ESP_LOGI(TAG, "I2C bus scan on SDA=%d SCL=%d", I2C_SDA_IO, I2C_SCL_IO);
+    strcpy(line, "    ");
+    for (int i = 0; i < 16; i++) {
+        char tmp[4];
+        snprintf(tmp, sizeof(tmp), "%02X ", i);
+        strncat(line, tmp, sizeof(line) - strlen(line) - 1);
     }
+    ESP_LOGI(TAG, "%s", line);
 
     for (int high = 0; high < 8; high++) {
-        if (log_results) {
-            snprintf(line, sizeof(line), "%02X: ", high << 4);
-        }
-
+        snprintf(line, sizeof(line), "%02X: ", high << 4);
         for (int low = 0; low < 16; low++) {
             uint8_t addr = (high << 4) | low;
             char cell[4] = "   ";
-
-            if (addr >= 0x03 && addr <= 0x77) {
-                esp_err_t err =
-                    i2c_master_probe(s_i2c_bus, addr, I2C_TIMEOUT_MS);
-                if (err == ESP_OK) {
-                    if (addresses && stored < max_addresses) {
-                        addresses[stored++] = addr;
-                    }
-                    found++;
-                    if (log_results) {
-                        snprintf(cell, sizeof(cell), "%02X ", addr);
-                    }
-                } else if (log_results) {
+            if (addr >= I2C_SCAN_FIRST && addr <= I2C_SCAN_LAST) {
+                if (addr_set_has(found, addr)) {
+                    snprintf(cell, sizeof(cell), "%02X ", addr);
+                    count++;
+                } else {
                     snprintf(cell, sizeof(cell), "-- ");
                 }
             }
-
-            if (log_results) {
-                strncat(line, cell, sizeof(line) - strlen(line) - 1);
-            }
+            strncat(line, cell, sizeof(line) - strlen(line) - 1);
         }
+        ESP_LOGI(TAG, "%s", line);
+    }
 
-        if (log_results) {
-            ESP_LOGI(TAG, "%s", line);
+    ESP_LOGI(TAG, "Scan complete, found %u device(s)", (unsigned int)count);
+    if (count > I2C_DETECTED_MAX) {
+        ESP_LOGW(TAG, "Detected device list truncated to %u entrie(s)",
+                 (unsigned int)I2C_DETECTED_MAX);
+    }
+}
+
+static void json_write_addrs(json_writer_t* w, const char* key,
+                             const uint32_t* set) {
+    json_writer_key(w, key);
+    json_writer_array_begin(w);
+    for (int addr = I2C_SCAN_FIRST; addr <= I2C_SCAN_LAST; ++addr) {
+        if (addr_set_has(set, (uint8_t)addr)) {
+            json_writer_uint(w, (uint64_t)addr);
         }
     }
+    json_writer_array_end(w);
+}
 
-    if (log_results) {
-        ESP_LOGI(TAG, "Scan complete, found %u device(s)", (unsigned int)found);
-        if (stored < found) {
-            ESP_LOGW(TAG, "Detected device list truncated to %u entrie(s)",
-                     (unsigned int)stored);
+// Stores a finished scan pass for /i2cinfo and reports what changed.
+static void i2c_scan_apply(const uint32_t* found, bool first) {
+    uint32_t added[4];
+    uint32_t removed[4];
+    bool changed = false;
+
+    xSemaphoreTake(s_detected_mutex, portMAX_DELAY);
+    s_detected_i2c_count = 0;
+    for (int i = 0; i < 4; ++i) {
+        added[i] = found[i] & ~s_detected_set[i];
+        removed[i] = s_detected_set[i] & ~found[i];
+        changed |= (added[i] | removed[i]) != 0;
+        s_detected_set[i] = found[i];
+    }
+    for (int addr = I2C_SCAN_FIRST; addr <= I2C_SCAN_LAST; ++addr) {
+        if (addr_set_has(found, (uint8_t)addr) &&
+            s_detected_i2c_count < I2C_DETECTED_MAX) {
+            s_detected_i2c_addresses[s_detected_i2c_count++] = (uint8_t)addr;
+        }
+    }
+    size_t count = s_detected_i2c_count;
+    xSemaphoreGive(s_detected_mutex);
+    metrics_counter_inc(&s_scan_passes);
+
+    if (first) {
+        i2c_log_scan(found);
+    } else {
+        for (int addr = I2C_SCAN_FIRST; addr <= I2C_SCAN_LAST; ++addr) {
+            if (addr_set_has(added, (uint8_t)addr)) {
+                ESP_LOGI(TAG, "I2C device 0x%02X appeared", addr);
+            } else if (addr_set_has(removed, (uint8_t)addr)) {
+                ESP_LOGW(TAG, "I2C device 0x%02X disappeared", addr);
+            }
         }
     }
 
-    *count = stored;
-    return ESP_OK;
+    // The dashboard may have loaded /i2cinfo before the first pass finished
+    if (first || changed) {
+        char msg[I2C_SCAN_MSG_MAX];
+        json_writer_t w;
+        json_writer_init(&w, msg, sizeof(msg), NULL, NULL);
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "type", "i2c-scan");
+        json_writer_kv_uint(&w, "detected", count);
+        json_write_addrs(&w, "added", added);
+        json_write_addrs(&w, "removed", removed);
+        json_writer_object_end(&w);
+        // finish() only terminates the string if there is room left for the
+        // NUL
+        esp_err_t err = json_writer_finish(&w);
+        if (err == ESP_OK && w.len < sizeof(msg)) {
+            websocket_broadcast(msg);
+        } else {
+            ESP_LOGW(TAG, "I2C scan message too long");
+        }
+    }
 }
 
-static esp_err_t i2c_refresh_detected_devices(bool log_results) {
-    size_t detected_count = 0;
-    esp_err_t err = i2c_scan_devices(
-        s_detected_i2c_addresses,
-        sizeof(s_detected_i2c_addresses) / sizeof(s_detected_i2c_addresses[0]),
-        &detected_count, log_results);
-    if (err != ESP_OK) {
-        return err;
-    }
+// Probes every address, one at a time under the bus mutex with a pause in
+// between, so engine transfers and sensor polls get the bus between probes.
+static void i2c_scan_task(void* arg) {
+    (void)arg;
+    bool first = true;
+    for (;;) {
+        uint32_t found[4] = {0};
+        for (int addr = I2C_SCAN_FIRST; addr <= I2C_SCAN_LAST; ++addr) {
+            xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
+            if (!s_i2c_bus) {  // i2c_deinit()
+                xSemaphoreGive(s_bus_mutex);
+                goto done;
+            }
+            esp_err_t err = i2c_master_probe(s_i2c_bus, (uint16_t)addr,
+                                             CONFIG_VE_I2C_PROBE_TIMEOUT_MS);
+            xSemaphoreGive(s_bus_mutex);
+            if (err == ESP_OK) {
+                found[addr / 32] |= 1u << (addr % 32);
+            }
+            vTaskDelay(1);
+        }
+        i2c_scan_apply(found, first);
+        first = false;
 
-    s_detected_i2c_count = detected_count;
-    return ESP_OK;
+        if (CONFIG_VE_I2C_RESCAN_INTERVAL_S == 0) break;
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_VE_I2C_RESCAN_INTERVAL_S * 1000));
+    }
+done:
+    s_scan_task = NULL;
+    vTaskDelete(NULL);
 }
 
 esp_err_t i2c_init(void) {
@@ -115,6 +258,19 @@ esp_err_t i2c_init(void) {
     ESP_LOGI(TAG, "Bus initializing... SCL=%d SDA=%d FREQ=%dHz", I2C_SCL_IO,
              I2C_SDA_IO, I2C_FREQ_HZ);
 
+    if (!s_bus_mutex) {
+        s_bus_mutex = xSemaphoreCreateMutex();
+        if (!s_bus_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!s_detected_mutex) {
+        s_detected_mutex = xSemaphoreCreateMutex();
+        if (!s_detected_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     i2c_master_bus_config_t cfg = {
         .clk_source = I2C_CLK_SRC_DEFAULT,
         .i2c_port = I2C_PORT,
@@ -132,14 +288,81 @@ esp_err_t i2c_init(void) {
     }
 
     ESP_LOGI(TAG, "Bus initialized successfully");
-    err = i2c_refresh_detected_devices(true);
+    err = i2c_async_start();
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Initial I2C scan failed: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "Queued transfers unavailable: %s",
+                 esp_err_to_name(err));
+    }
+    err = sensors_init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Sensor polling unavailable: %s", esp_err_to_name(err));
+    }
+
+    // Probing all 117 addresses takes a while; /i2cinfo serves the last
+    // completed pass, and clients hear about changes on the websocket
+    if (!s_scan_task &&
+        xTaskCreate(i2c_scan_task, "ve_i2c_scan", I2C_SCAN_TASK_STACK, NULL,
+                    tskIDLE_PRIORITY + 1, &s_scan_task) != pdPASS) {
+        s_scan_task = NULL;
+        ESP_LOGW(TAG, "I2C bus scan unavailable: %s",
+                 esp_err_to_name(ESP_ERR_NO_MEM));
     }
 
     return ESP_OK;
 }
 
+static bool reg_in(const VigilantI2CRegRange* ranges, size_t count,
+                   unsigned reg) {
+    for (size_t i = 0; i < count; ++i) {
+        if (reg >= ranges[i].first && reg <= ranges[i].last) return true;
+    }
+    return false;
+}
+
+static bool reg_cacheable(const VigilantI2CRegCache* c, unsigned reg) {
+    return !reg_in(c->volatile_ranges, c->volatile_count, reg) &&
+           reg_in(c->cacheable, c->cacheable_count, reg);
+}
+
+static bool reg_cached(const VigilantI2CRegCache* c, unsigned reg) {
+    return reg_cacheable(c, reg) && (c->valid[reg / 32] & (1u << (reg % 32)));
+}
+
+// True if the whole block can be served from the cache.
+static bool cache_covers(const VigilantI2CRegCache* c, uint8_t reg,
+                         size_t len) {
+    if (len == 0 || reg + len > sizeof(c->values)) return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (!reg_cached(c, reg + i)) return false;
+    }
+    return true;
+}
+
+// Records what the device holds after a transfer; NULL `data` forgets the
+// block. Returns whether any register of it is cacheable.
+static bool cache_store(VigilantI2CRegCache* c, uint8_t reg,
+                        const uint8_t* data, size_t len) {
+    bool any = false;
+    for (size_t i = 0; i < len && reg + i < sizeof(c->values); ++i) {
+        unsigned r = reg + i;
+        if (!reg_cacheable(c, r)) continue;
+        any = true;
+        if (data) {
+            c->values[r] = data[i];
+            c->valid[r / 32] |= 1u << (r % 32);
+        } else {
+            c->valid[r / 32] &= ~(1u << (r % 32));
+        }
+    }
+    return any;
+}
+
+static void i2c_cache_record(const VigilantI2CDevice* device, bool hit) {
+    i2c_dev_stats_t* stats = i2c_dev_stats(device->address, false);
+    if (!stats) return;
+    metrics_counter_inc(hit ? &stats->cache_hits : &stats->cache_misses);
+}
+
 esp_err_t i2c_add_device(VigilantI2CDevice* device) {
     if (!s_i2c_bus) {
         return ESP_ERR_INVALID_STATE;
@@ -167,6 +390,14 @@ esp_err_t i2c_add_device(VigilantI2CDevice* device) {
         return err;
     }
 
+    // The device may have been reset since the cache was last used
+    if (device->cache) {
+        memset(device->cache->valid, 0, sizeof(device->cache->valid));
+    }
+    if (!i2c_dev_stats(device->address, true)) {
+        ESP_LOGW(TAG, "No stats slot for I2C device 0x%02X",
+                 (unsigned int)device->address);
+    }
     return ESP_OK;
 }
 
@@ -174,6 +405,12 @@ esp_err_t i2c_remove_device(VigilantI2CDevice* device) {
     if (!device || !device->handle) {
         return ESP_ERR_INVALID_ARG;
     }
+    // Sensors cannot be removed, and would keep polling a stale handle
+    if (sensors_use_device(device)) {
+        ESP_LOGE(TAG, "Device 0x%02X is polled by a sensor",
+                 (unsigned)device->address);
+        return ESP_ERR_INVALID_STATE;
+    }
 
     esp_err_t err = i2c_master_bus_rm_device(device->handle);
     if (err == ESP_OK) {
@@ -183,6 +420,51 @@ esp_err_t i2c_remove_device(VigilantI2CDevice* device) {
     return err;
 }
 
+// Transfers without checks; the caller holds s_bus_mutex, which also guards
+// the device's register cache.
+static esp_err_t i2c_read_locked(VigilantI2CDevice* device, uint8_t reg,
+                                 uint8_t* data, size_t len) {
+    VigilantI2CRegCache* cache = device->cache;
+    if (cache && cache_covers(cache, reg, len)) {
+        memcpy(data, &cache->values[reg], len);
+        i2c_cache_record(device, true);
+        return ESP_OK;
+    }
+
+    esp_err_t err = i2c_master_transmit_receive(device->handle, &reg, 1, data,
+                                                len, I2C_TIMEOUT_MS);
+    i2c_record(device, err, 1 + len);
+    if (cache && err == ESP_OK && cache_store(cache, reg, data, len)) {
+        i2c_cache_record(device, false);
+    }
+    return err;
+}
+
+static esp_err_t i2c_write_locked(VigilantI2CDevice* device, uint8_t reg,
+                                  const uint8_t* data, size_t len) {
+    VigilantI2CRegCache* cache = device->cache;
+    if (cache && cache_covers(cache, reg, len) &&
+        memcmp(&cache->values[reg], data, len) == 0) {
+        i2c_cache_record(device, true);
+        return ESP_OK;
+    }
+
+    i2c_master_transmit_multi_buffer_info_t buffers[2] = {
+        {.write_buffer = &reg, .buffer_size = 1},
+        {.write_buffer = data, .buffer_size = len},
+    };
+    size_t buffer_count = (len > 0) ? 2 : 1;
+
+    esp_err_t err = i2c_master_multi_buffer_transmit(
+        device->handle, buffers, buffer_count, I2C_TIMEOUT_MS);
+    i2c_record(device, err, 1 + len);
+    // After a failed write the device may hold either value
+    if (cache && cache_store(cache, reg, err == ESP_OK ? data : NULL, len)) {
+        i2c_cache_record(device, false);
+    }
+    return err;
+}
+
 esp_err_t i2c_read_regs(VigilantI2CDevice* device, uint8_t reg, uint8_t* data,
                         size_t len) {
     if (!device) {
@@ -206,8 +488,10 @@ esp_err_t i2c_read_regs(VigilantI2CDevice* device, uint8_t reg, uint8_t* data,
         return ESP_OK;
     }
 
-    return i2c_master_transmit_receive(device->handle, &reg, 1, data, len,
-                                       I2C_TIMEOUT_MS);
+    xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
+    esp_err_t err = i2c_read_locked(device, reg, data, len);
+    xSemaphoreGive(s_bus_mutex);
+    return err;
 }
 
 esp_err_t i2c_write_regs(VigilantI2CDevice* device, uint8_t reg,
@@ -229,14 +513,88 @@ esp_err_t i2c_write_regs(VigilantI2CDevice* device, uint8_t reg,
         return ESP_ERR_INVALID_ARG;
     }
 
-    i2c_master_transmit_multi_buffer_info_t buffers[2] = {
-        {.write_buffer = &reg, .buffer_size = 1},
-        {.write_buffer = data, .buffer_size = len},
-    };
-    size_t buffer_count = (len > 0) ? 2 : 1;
+    xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
+    esp_err_t err = i2c_write_locked(device, reg, data, len);
+    xSemaphoreGive(s_bus_mutex);
+    return err;
+}
 
-    return i2c_master_multi_buffer_transmit(device->handle, buffers,
-                                            buffer_count, I2C_TIMEOUT_MS);
+static esp_err_t i2c_op_check(const VigilantI2COp* op) {
+    switch (op->type) {
+        case VIGILANT_I2C_OP_READ:
+            return op->device && op->device->handle && (op->rx || !op->len)
+                       ? ESP_OK
+                       : ESP_ERR_INVALID_ARG;
+        case VIGILANT_I2C_OP_WRITE:
+            return op->device && op->device->handle && (op->tx || !op->len)
+                       ? ESP_OK
+                       : ESP_ERR_INVALID_ARG;
+        case VIGILANT_I2C_OP_DELAY:
+            return ESP_OK;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static void i2c_delay_us(uint32_t us) {
+    // Busy-wait below one tick, where vTaskDelay() would round up a lot
+    if (us < portTICK_PERIOD_MS * 1000) {
+        esp_rom_delay_us(us);
+    } else {
+        vTaskDelay(pdMS_TO_TICKS((us + 999) / 1000));
+    }
+}
+
+esp_err_t i2c_transaction(VigilantI2COp* ops, size_t count) {
+    if (!ops && count > 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_i2c_bus) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Check everything first, so a bad entry does not leave a device
+    // half configured
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < count; ++i) {
+        ops[i].result = i2c_op_check(&ops[i]);
+        if (ops[i].result != ESP_OK && err == ESP_OK) {
+            ESP_LOGE(TAG, "Transaction entry %u is invalid", (unsigned)i);
+            err = ops[i].result;
+        }
+    }
+    if (err != ESP_OK) {
+        for (size_t i = 0; i < count; ++i) {
+            if (ops[i].result == ESP_OK) ops[i].result = ESP_ERR_NOT_FINISHED;
+        }
+        return err;
+    }
+
+    xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < count; ++i) {
+        VigilantI2COp* op = &ops[i];
+        if (err != ESP_OK) {
+            op->result = ESP_ERR_NOT_FINISHED;
+            continue;
+        }
+        switch (op->type) {
+            case VIGILANT_I2C_OP_READ:
+                op->result = op->len > 0 ? i2c_read_locked(op->device, op->reg,
+                                                           op->rx, op->len)
+                                         : ESP_OK;
+                break;
+            case VIGILANT_I2C_OP_WRITE:
+                op->result =
+                    i2c_write_locked(op->device, op->reg, op->tx, op->len);
+                break;
+            case VIGILANT_I2C_OP_DELAY:
+                i2c_delay_us(op->delay_us);
+                op->result = ESP_OK;
+                break;
+        }
+        err = op->result;
+    }
+    xSemaphoreGive(s_bus_mutex);
+    return err;
 }
 
 esp_err_t i2c_set_reg8(VigilantI2CDevice* device, uint8_t reg, uint8_t value) {
@@ -248,6 +606,38 @@ esp_err_t i2c_read_reg8(VigilantI2CDevice* device, uint8_t reg,
     return i2c_read_regs(device, reg, value, 1);
 }
 
+esp_err_t i2c_update_bits(VigilantI2CDevice* device, uint8_t reg, uint8_t mask,
+                          uint8_t value) {
+    if (!device || !device->handle) {
+        ESP_LOGE(TAG, "Cannot update register 0x%02X: device not added", reg);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
+    uint8_t current = 0;
+    esp_err_t err = i2c_read_locked(device, reg, &current, 1);
+    if (err == ESP_OK) {
+        uint8_t next = (uint8_t)((current & ~mask) | (value & mask));
+        if (next != current) {
+            err = i2c_write_locked(device, reg, &next, 1);
+        }
+    }
+    xSemaphoreGive(s_bus_mutex);
+    return err;
+}
+
+esp_err_t i2c_set_bits(VigilantI2CDevice* device, uint8_t reg, uint8_t bits) {
+    return i2c_update_bits(device, reg, bits, bits);
+}
+
+void i2c_cache_invalidate(VigilantI2CDevice* device) {
+    if (!device || !device->cache) return;
+
+    if (s_bus_mutex) xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
+    memset(device->cache->valid, 0, sizeof(device->cache->valid));
+    if (s_bus_mutex) xSemaphoreGive(s_bus_mutex);
+}
+
 esp_err_t i2c_whoami_check(VigilantI2CDevice* device) {
     if (!device) {
         ESP_LOGE(TAG, "Cannot run WHOAMI check: device object is NULL");
@@ -282,6 +672,7 @@ esp_err_t i2c_get_detected_devices(uint8_t* addresses, size_t max_addresses,
         return ESP_ERR_INVALID_STATE;
     }
 
+    xSemaphoreTake(s_detected_mutex, portMAX_DELAY);
     size_t copied_count = s_detected_i2c_count;
     if (copied_count > max_addresses) {
         copied_count = max_addresses;
@@ -291,21 +682,89 @@ esp_err_t i2c_get_detected_devices(uint8_t* addresses, size_t max_addresses,
         memcpy(addresses, s_detected_i2c_addresses,
                copied_count * sizeof(s_detected_i2c_addresses[0]));
     }
+    xSemaphoreGive(s_detected_mutex);
 
     *count = copied_count;
     return ESP_OK;
 }
 
+void i2c_write_metrics(metrics_out_t* out) {
+    static const struct {
+        const char* name;
+        const char* help;
+        size_t offset;
+    } families[] = {
+        {"ve_i2c_transactions_total", "I2C transactions per device",
+         offsetof(i2c_dev_stats_t, transactions)},
+        {"ve_i2c_nacks_total", "I2C transactions NACKed per device",
+         offsetof(i2c_dev_stats_t, nacks)},
+        {"ve_i2c_timeouts_total", "I2C transactions timed out per device",
+         offsetof(i2c_dev_stats_t, timeouts)},
+        {"ve_i2c_bytes_total", "I2C bytes transferred per device",
+         offsetof(i2c_dev_stats_t, bytes)},
+        {"ve_i2c_cache_hits_total",
+         "Register reads and writes the register cache kept off the bus",
+         offsetof(i2c_dev_stats_t, cache_hits)},
+        {"ve_i2c_cache_misses_total",
+         "Transfers of cacheable registers that went to the bus",
+         offsetof(i2c_dev_stats_t, cache_misses)},
+    };
+
+    for (size_t f = 0; f < sizeof(families) / sizeof(families[0]); ++f) {
+        metrics_family(out, families[f].name, "counter", families[f].help);
+        for (int i = 0; i < I2C_STATS_MAX_DEVICES; ++i) {
+            const i2c_dev_stats_t* stats = &s_dev_stats[i];
+            uint16_t address =
+                __atomic_load_n(&stats->address, __ATOMIC_ACQUIRE);
+            if (address == 0) {
+                continue;
+            }
+            char labels[24];
+            snprintf(labels, sizeof(labels), "address=\"0x%02X\"",
+                     (unsigned int)address);
+            const metrics_counter_t* counter =
+                (const metrics_counter_t*)((const char*)stats +
+                                           families[f].offset);
+            metrics_sample(out, families[f].name, labels,
+                           metrics_counter_read(counter));
+        }
+    }
+
+    metrics_family(out, "ve_i2c_scan_passes_total", "counter",
+                   "Completed background I2C bus scans");
+    metrics_sample(out, "ve_i2c_scan_passes_total", NULL,
+                   metrics_counter_read(&s_scan_passes));
+
+    i2c_async_write_metrics(out);
+    sensors_write_metrics(out);
+}
+
 void i2c_deinit(void) {
     if (s_i2c_bus) {
+        // Before the bus mutex: the poll and bus tasks may need it for the
+        // transfer in flight
+        sensors_stop();
+        i2c_async_stop();
+
+        // Waits out a probe in flight; the scan task exits on its next one
+        xSemaphoreTake(s_bus_mutex, portMAX_DELAY);
         esp_err_t err = i2c_del_master_bus(s_i2c_bus);
+        if (err == ESP_OK) {
+            s_i2c_bus = NULL;
+        }
+        xSemaphoreGive(s_bus_mutex);
         if (err != ESP_OK) {
             ESP_LOGW(TAG, "Failed to delete I2C bus: %s", esp_err_to_name(err));
+            // The bus still works; keep serving it
+            (void)i2c_async_start();
+            (void)sensors_init();
             return;
         }
 
-        s_i2c_bus = NULL;
+        xSemaphoreTake(s_detected_mutex, portMAX_DELAY);
         memset(s_detected_i2c_addresses, 0, sizeof(s_detected_i2c_addresses));
+        memset(s_detected_set, 0, sizeof(s_detected_set));
         s_detected_i2c_count = 0;
+        xSemaphoreGive(s_detected_mutex);
     }
 }
@@ -0,0 +1,296 @@
+#include "i2c_async.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "i2c.h"
+#include "sdkconfig.h"
+
+static const char* TAG_I2C_ASYNC = "ve_i2c_async";
+
+#define I2C_ASYNC_PRIORITIES 2
+#define I2C_BUS_TASK_STACK 3072
+
+typedef struct {
+    VigilantI2CDevice* device;  // NULL for a transaction list
+    uint8_t reg;
+    bool write;
+    uint8_t* data;  // const for writes
+    size_t len;
+    VigilantI2COp* ops;
+    size_t op_count;
+    VigilantI2CAsync done;
+    int64_t queued_at;
+} i2c_request_t;
+
+typedef struct {
+    QueueHandle_t queue;
+    metrics_counter_t completed;
+    metrics_counter_t rejected;   // queue full
+    metrics_counter_t cancelled;  // still queued when the bus task stopped
+    uint32_t max_depth;           // high-water mark of the queue
+    uint64_t wait_us_total;       // written by the bus task only
+    uint32_t wait_us_max;
+} i2c_async_lane_t;
+
+// Indexed by VigilantI2CPriority
+static i2c_async_lane_t s_lanes[I2C_ASYNC_PRIORITIES];
+// Guards s_bus_task, so a submission never notifies a task that has exited
+// or queues behind i2c_async_stop()'s drain
+static SemaphoreHandle_t s_task_mutex = NULL;
+static TaskHandle_t s_bus_task = NULL;
+static bool s_stopping = false;  // set by i2c_async_stop(), cleared on exit
+
+static void i2c_request_complete(const i2c_request_t* r, esp_err_t err) {
+    if (r->done.result) {
+        *r->done.result = err;
+    }
+    if (r->done.callback) {
+        r->done.callback(r->device, err, r->done.arg);
+    }
+    if (r->done.notify_task) {
+        xTaskNotifyGive(r->done.notify_task);
+    }
+}
+
+static void i2c_request_run(i2c_request_t* r) {
+    int64_t start = esp_timer_get_time();
+    i2c_async_lane_t* lane = &s_lanes[r->done.priority];
+    int64_t waited = start - r->queued_at;
+    uint32_t wait_us = waited > UINT32_MAX ? UINT32_MAX : (uint32_t)waited;
+    __atomic_fetch_add(&lane->wait_us_total, wait_us, __ATOMIC_RELAXED);
+    if (wait_us > __atomic_load_n(&lane->wait_us_max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&lane->wait_us_max, wait_us, __ATOMIC_RELAXED);
+    }
+
+    esp_err_t err;
+    if (!r->device) {
+        err = i2c_transaction(r->ops, r->op_count);
+    } else if (r->write) {
+        err = i2c_write_regs(r->device, r->reg, r->data, r->len);
+    } else {
+        err = i2c_read_regs(r->device, r->reg, r->data, r->len);
+    }
+    metrics_counter_inc(&lane->completed);
+    i2c_request_complete(r, err);
+}
+
+static bool i2c_bus_stopping(void) {
+    return __atomic_load_n(&s_stopping, __ATOMIC_ACQUIRE);
+}
+
+// Owns the queued transfers. The high priority queue is checked again before
+// every transfer, so a control loop read waits for at most one housekeeping
+// transfer.
+static void i2c_bus_task(void* arg) {
+    (void)arg;
+    i2c_request_t r;
+    while (!i2c_bus_stopping()) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (!i2c_bus_stopping() &&
+               (xQueueReceive(s_lanes[VIGILANT_I2C_PRIORITY_HIGH].queue, &r,
+                              0) == pdTRUE ||
+                xQueueReceive(s_lanes[VIGILANT_I2C_PRIORITY_LOW].queue, &r,
+                              0) == pdTRUE)) {
+            i2c_request_run(&r);
+        }
+    }
+    __atomic_store_n(&s_stopping, false, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+
+esp_err_t i2c_async_start(void) {
+    if (!s_task_mutex) {
+        s_task_mutex = xSemaphoreCreateMutex();
+        if (!s_task_mutex) return ESP_ERR_NO_MEM;
+    }
+    if (s_bus_task) return ESP_OK;
+
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        if (!s_lanes[i].queue) {
+            s_lanes[i].queue = xQueueCreate(CONFIG_VE_I2C_ASYNC_QUEUE_DEPTH,
+                                            sizeof(i2c_request_t));
+        }
+        if (!s_lanes[i].queue) {
+            ESP_LOGE(TAG_I2C_ASYNC, "queue create failed");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreate(i2c_bus_task, "ve_i2c_bus", I2C_BUS_TASK_STACK, NULL,
+                    CONFIG_VE_I2C_TASK_PRIORITY, &task) != pdPASS) {
+        ESP_LOGE(TAG_I2C_ASYNC, "bus task create failed");
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(s_task_mutex, portMAX_DELAY);
+    s_bus_task = task;
+    xSemaphoreGive(s_task_mutex);
+    return ESP_OK;
+}
+
+void i2c_async_stop(void) {
+    if (!s_task_mutex) return;
+
+    xSemaphoreTake(s_task_mutex, portMAX_DELAY);
+    TaskHandle_t task = s_bus_task;
+    s_bus_task = NULL;
+    xSemaphoreGive(s_task_mutex);
+    if (!task) return;
+
+    // The task finishes the transfer in flight, then exits
+    __atomic_store_n(&s_stopping, true, __ATOMIC_RELEASE);
+    xTaskNotifyGive(task);
+    while (i2c_bus_stopping()) {
+        vTaskDelay(1);
+    }
+
+    // The queues stay for the next i2c_async_start()
+    i2c_request_t r;
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        while (xQueueReceive(s_lanes[i].queue, &r, 0) == pdTRUE) {
+            metrics_counter_inc(&s_lanes[i].cancelled);
+            i2c_request_complete(&r, ESP_ERR_INVALID_STATE);
+        }
+    }
+}
+
+static esp_err_t i2c_async_submit(i2c_request_t* r,
+                                  const VigilantI2CAsync* done) {
+    if (!done || (unsigned)done->priority >= I2C_ASYNC_PRIORITIES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_task_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    i2c_async_lane_t* lane = &s_lanes[done->priority];
+    r->done = *done;
+    r->queued_at = esp_timer_get_time();
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_task_mutex, portMAX_DELAY);
+    if (!s_bus_task) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (xQueueSend(lane->queue, r, 0) != pdTRUE) {
+        metrics_counter_inc(&lane->rejected);
+        err = ESP_ERR_NO_MEM;
+    } else {
+        xTaskNotifyGive(s_bus_task);
+    }
+    xSemaphoreGive(s_task_mutex);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint32_t depth = (uint32_t)uxQueueMessagesWaiting(lane->queue);
+    if (depth > __atomic_load_n(&lane->max_depth, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&lane->max_depth, depth, __ATOMIC_RELAXED);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_read_regs_async(VigilantI2CDevice* device, uint8_t reg,
+                              uint8_t* data, size_t len,
+                              const VigilantI2CAsync* done) {
+    if (!device || !device->handle || (!data && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_request_t r = {
+        .device = device,
+        .reg = reg,
+        .write = false,
+        .data = data,
+        .len = len,
+    };
+    return i2c_async_submit(&r, done);
+}
+
+esp_err_t i2c_write_regs_async(VigilantI2CDevice* device, uint8_t reg,
+                               const uint8_t* data, size_t len,
+                               const VigilantI2CAsync* done) {
+    if (!device || !device->handle || (!data && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_request_t r = {
+        .device = device,
+        .reg = reg,
+        .write = true,
+        .data = (uint8_t*)data,  // the bus task only reads it for writes
+        .len = len,
+    };
+    return i2c_async_submit(&r, done);
+}
+
+esp_err_t i2c_transaction_async(VigilantI2COp* ops, size_t count,
+                                const VigilantI2CAsync* done) {
+    if (!ops && count > 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_request_t r = {
+        .device = NULL,
+        .ops = ops,
+        .op_count = count,
+    };
+    return i2c_async_submit(&r, done);
+}
+
+void i2c_async_write_metrics(metrics_out_t* out) {
+    static const char* const labels[I2C_ASYNC_PRIORITIES] = {
+        "priority=\"low\"",
+        "priority=\"high\"",
+    };
+
+    metrics_family(out, "ve_i2c_async_queued", "gauge",
+                   "Queued I2C transfers waiting for the bus task");
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        metrics_sample(
+            out, "ve_i2c_async_queued", labels[i],
+            s_lanes[i].queue ? uxQueueMessagesWaiting(s_lanes[i].queue) : 0);
+    }
+    metrics_family(out, "ve_i2c_async_queued_max", "gauge",
+                   "Most queued I2C transfers seen at once");
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        metrics_sample(out, "ve_i2c_async_queued_max", labels[i],
+                       __atomic_load_n(&s_lanes[i].max_depth,
+                                       __ATOMIC_RELAXED));
+    }
+
+    metrics_family(out, "ve_i2c_async_requests_total", "counter",
+                   "Queued I2C transfers by outcome");
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        char outcome[48];
+        snprintf(outcome, sizeof(outcome), "%s,outcome=\"done\"", labels[i]);
+        metrics_sample(out, "ve_i2c_async_requests_total", outcome,
+                       metrics_counter_read(&s_lanes[i].completed));
+        snprintf(outcome, sizeof(outcome), "%s,outcome=\"rejected\"",
+                 labels[i]);
+        metrics_sample(out, "ve_i2c_async_requests_total", outcome,
+                       metrics_counter_read(&s_lanes[i].rejected));
+        snprintf(outcome, sizeof(outcome), "%s,outcome=\"cancelled\"",
+                 labels[i]);
+        metrics_sample(out, "ve_i2c_async_requests_total", outcome,
+                       metrics_counter_read(&s_lanes[i].cancelled));
+    }
+
+    metrics_family(out, "ve_i2c_async_wait_us_total", "counter",
+                   "Time I2C transfers spent in the queue");
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        metrics_sample(out, "ve_i2c_async_wait_us_total", labels[i],
+                       __atomic_load_n(&s_lanes[i].wait_us_total,
+                                       __ATOMIC_RELAXED));
+    }
+    metrics_family(out, "ve_i2c_async_wait_us_max", "gauge",
+                   "Longest time an I2C transfer spent in the queue");
+    for (int i = 0; i < I2C_ASYNC_PRIORITIES; ++i) {
+        metrics_sample(out, "ve_i2c_async_wait_us_max", labels[i],
+                       __atomic_load_n(&s_lanes[i].wait_us_max,
+                                       __ATOMIC_RELAXED));
+    }
+}
@@ -0,0 +1,211 @@
+#include "i2c_bench.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "http_server.h"
+#include "i2c.h"
+#include "i2c_async.h"
+#include "json_writer.h"
+
+static const char* TAG_BENCH = "ve_i2c_bench";
+
+#define I2C_BENCH_MAX_OPS 8
+#define I2C_BENCH_MAX_LEN 32
+#define I2C_BENCH_MAX_ROUNDS 1000
+
+typedef enum {
+    I2C_BENCH_SINGLE,        // one i2c_read_regs() per register block
+    I2C_BENCH_LIST,          // one i2c_transaction() per round
+    I2C_BENCH_ASYNC_SINGLE,  // one queued read per block, awaited
+    I2C_BENCH_ASYNC_LIST,    // one queued list per round, awaited
+    I2C_BENCH_MODES,
+} i2c_bench_mode_t;
+
+static const char* const s_mode_names[I2C_BENCH_MODES] = {
+    "single",
+    "list",
+    "async_single",
+    "async_list",
+};
+
+typedef struct {
+    VigilantI2CDevice* device;
+    uint8_t reg;
+    size_t len;
+    size_t ops;
+    uint32_t rounds;
+    VigilantI2COp list[I2C_BENCH_MAX_OPS];
+    uint8_t data[I2C_BENCH_MAX_OPS][I2C_BENCH_MAX_LEN];
+} i2c_bench_t;
+
+// Waits for the bus task without a timeout: a transfer ends after the bus
+// timeout at the latest, and it writes into our buffers until then.
+static esp_err_t bench_wait(esp_err_t queued, const esp_err_t* result) {
+    if (queued != ESP_OK) return queued;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return *result;
+}
+
+// Returns the number of failed transfers.
+static uint32_t bench_run(i2c_bench_t* b, i2c_bench_mode_t mode) {
+    esp_err_t result = ESP_OK;
+    VigilantI2CAsync done = {
+        .priority = VIGILANT_I2C_PRIORITY_HIGH,
+        .result = &result,
+        .notify_task = xTaskGetCurrentTaskHandle(),
+    };
+
+    uint32_t errors = 0;
+    for (uint32_t round = 0; round < b->rounds; ++round) {
+        switch (mode) {
+            case I2C_BENCH_SINGLE:
+                for (size_t i = 0; i < b->ops; ++i) {
+                    errors += i2c_read_regs(b->device, b->reg, b->data[i],
+                                            b->len) != ESP_OK;
+                }
+                break;
+            case I2C_BENCH_LIST:
+                (void)i2c_transaction(b->list, b->ops);
+                break;
+            case I2C_BENCH_ASYNC_SINGLE:
+                for (size_t i = 0; i < b->ops; ++i) {
+                    errors += bench_wait(i2c_read_regs_async(b->device, b->reg,
+                                                             b->data[i], b->len,
+                                                             &done),
+                                         &result) != ESP_OK;
+                }
+                break;
+            case I2C_BENCH_ASYNC_LIST:
+                if (i2c_transaction_async(b->list, b->ops, &done) != ESP_OK) {
+                    errors += b->ops;
+                    continue;
+                }
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                break;
+            default:
+                break;
+        }
+        if (mode == I2C_BENCH_LIST || mode == I2C_BENCH_ASYNC_LIST) {
+            for (size_t i = 0; i < b->ops; ++i) {
+                errors += b->list[i].result != ESP_OK;
+            }
+        }
+    }
+    return errors;
+}
+
+static uint32_t query_uint(const char* query, const char* key, uint32_t def,
+                           uint32_t min, uint32_t max) {
+    char value[12];
+    if (!query ||
+        httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return def;
+    }
+    unsigned long v = strtoul(value, NULL, 0);  // "0x6A" works too
+    return v < min ? min : v > max ? max : (uint32_t)v;
+}
+
+static esp_err_t i2cbench_get_handler(httpd_req_t* req) {
+    char query[96];
+    const char* q =
+        httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+            ? query
+            : NULL;
+
+    // Default to the first device found by the startup scan
+    uint8_t detected = 0;
+    size_t detected_count = 0;
+    (void)i2c_get_detected_devices(&detected, 1, &detected_count);
+    uint32_t address = query_uint(q, "addr", detected_count ? detected : 0,
+                                  0, 0x7F);
+    if (address < 0x03 || address > 0x77) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                   "No device: pass ?addr=0x..");
+    }
+
+    VigilantI2CDevice device = {.address = (uint16_t)address};
+    esp_err_t err = i2c_add_device(&device);
+    if (err != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Could not add device");
+    }
+
+    // Keep the buffers off the worker stack, next to the JSON buffer
+    i2c_bench_t* b = calloc(1, sizeof(*b));
+    if (!b) {
+        (void)i2c_remove_device(&device);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Out of memory");
+    }
+    b->device = &device;
+    b->reg = (uint8_t)query_uint(q, "reg", 0x00, 0, 0xFF);
+    b->len = query_uint(q, "len", 1, 1, I2C_BENCH_MAX_LEN);
+    b->ops = query_uint(q, "ops", 4, 1, I2C_BENCH_MAX_OPS);
+    b->rounds = query_uint(q, "rounds", 50, 1, I2C_BENCH_MAX_ROUNDS);
+    for (size_t i = 0; i < b->ops; ++i) {
+        b->list[i] = (VigilantI2COp){
+            .type = VIGILANT_I2C_OP_READ,
+            .device = &device,
+            .reg = b->reg,
+            .rx = b->data[i],
+            .len = b->len,
+        };
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    char buf[JSON_WRITER_HTTP_BUF];
+    json_writer_t w;
+    json_writer_init_httpd(&w, req, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_kv_uint(&w, "address", address);
+    json_writer_kv_uint(&w, "reg", b->reg);
+    json_writer_kv_uint(&w, "len", b->len);
+    json_writer_kv_uint(&w, "ops", b->ops);
+    json_writer_kv_uint(&w, "rounds", b->rounds);
+    json_writer_key(&w, "results");
+    json_writer_array_begin(&w);
+    for (int mode = 0; mode < I2C_BENCH_MODES; ++mode) {
+        int64_t start = esp_timer_get_time();
+        uint32_t errors = bench_run(b, (i2c_bench_mode_t)mode);
+        int64_t us = esp_timer_get_time() - start;
+        uint64_t transfers = (uint64_t)b->rounds * b->ops;
+
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "mode", s_mode_names[mode]);
+        json_writer_kv_uint(&w, "transfers", transfers);
+        json_writer_kv_uint(&w, "errors", errors);
+        json_writer_kv_uint(&w, "us", (uint64_t)us);
+        json_writer_kv_uint(&w, "per_second",
+                            us > 0 ? transfers * 1000000 / (uint64_t)us : 0);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    err = json_writer_finish(&w);
+
+    free(b);
+    (void)i2c_remove_device(&device);
+    return err;
+}
+
+esp_err_t i2c_bench_register_handlers(httpd_handle_t server) {
+    static const httpd_uri_t i2cbench_uri = {
+        .uri = "/i2cbench",
+        .method = HTTP_GET,
+        .handler = i2cbench_get_handler,
+        .user_ctx = NULL,
+    };
+
+    // Keeps the bus busy for a while; run it on a worker
+    esp_err_t err = http_server_register_async_uri(server, &i2cbench_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_BENCH, "Failed to register /i2cbench handler (%s)",
+                 esp_err_to_name(err));
+    }
+    return err;
+}
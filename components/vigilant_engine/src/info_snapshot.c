@@ -0,0 +1,143 @@
+#include "info_snapshot.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "json_writer.h"
+#include "vigilant.h"
+#include "websocket.h"
+
+static const char* TAG_INFO = "info";
+
+static SemaphoreHandle_t s_info_mutex = NULL;
+static char s_body[INFO_SNAPSHOT_MAX];
+static size_t s_body_len = 0;  // 0 until the first refresh
+static char s_etag[INFO_SNAPSHOT_ETAG_MAX];
+
+static SemaphoreHandle_t ensure_mutex(void) {
+    SemaphoreHandle_t mutex = __atomic_load_n(&s_info_mutex, __ATOMIC_ACQUIRE);
+    if (mutex) return mutex;
+
+    // The first call can come from a Wi-Fi event while the httpd task serves
+    // /info, before vigilant_init() refreshes the snapshot; one mutex wins.
+    mutex = xSemaphoreCreateMutex();
+    if (!mutex) return NULL;
+    SemaphoreHandle_t expected = NULL;
+    if (!__atomic_compare_exchange_n(&s_info_mutex, &expected, mutex, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        vSemaphoreDelete(mutex);
+        mutex = expected;
+    }
+    return mutex;
+}
+
+static uint32_t fnv1a(const char* data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t serialize_info(const VigilantInfo* info, char* buf,
+                             size_t size) {
+    json_writer_t w;
+    json_writer_init(&w, buf, size, NULL, NULL);
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "name", info->unique_component_name);
+    json_writer_kv_int(&w, "network_mode", (int)info->network_mode);
+    json_writer_kv_string(&w, "mac", info->mac);
+    json_writer_kv_string(&w, "ap_ssid", info->ap_ssid);
+    json_writer_kv_string(&w, "sta_ssid", info->sta_ssid);
+    json_writer_kv_string(&w, "ip_sta", info->ip_sta);
+    json_writer_kv_string(&w, "ip_ap", info->ip_ap);
+    json_writer_object_end(&w);
+    // finish() only terminates the string if there is room left for the NUL
+    if (json_writer_finish(&w) != ESP_OK || w.len >= size) return 0;
+    return w.len;
+}
+
+void info_snapshot_refresh(void) {
+    SemaphoreHandle_t mutex = ensure_mutex();
+    if (!mutex) return;
+
+    // Runs on the event loop task, whose stack is small: the body is
+    // serialized straight into s_body and the message goes on the heap
+    VigilantInfo info = {0};
+    esp_err_t err = vigilant_get_info(&info);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_INFO, "Info refresh failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t old_hash = s_body_len ? fnv1a(s_body, s_body_len) : 0;
+    size_t len = serialize_info(&info, s_body, sizeof(s_body));
+    uint32_t hash = len ? fnv1a(s_body, len) : 0;
+    bool changed = len != 0 && (len != s_body_len || hash != old_hash);
+    s_body_len = len;
+    if (changed) {
+        snprintf(s_etag, sizeof(s_etag), "\"%08" PRIx32 "\"", hash);
+    }
+    xSemaphoreGive(mutex);
+
+    if (len == 0) {
+        ESP_LOGE(TAG_INFO, "Info does not fit the snapshot buffer");
+        return;
+    }
+    if (changed) {
+        char* message = malloc(INFO_SNAPSHOT_MESSAGE_MAX);
+        if (message && info_snapshot_message(message,
+                                             INFO_SNAPSHOT_MESSAGE_MAX) ==
+                           ESP_OK) {
+            websocket_broadcast(message);
+        }
+        free(message);
+    }
+}
+
+esp_err_t info_snapshot_get(char* body, size_t body_size, char* etag,
+                            size_t etag_size) {
+    // NULL until the first refresh
+    SemaphoreHandle_t mutex = __atomic_load_n(&s_info_mutex, __ATOMIC_ACQUIRE);
+    if (!mutex) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (s_body_len == 0) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (s_body_len >= body_size) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(body, s_body, s_body_len + 1);
+        snprintf(etag, etag_size, "%s", s_etag);
+    }
+    xSemaphoreGive(mutex);
+    return err;
+}
+
+esp_err_t info_snapshot_message(char* out, size_t out_size) {
+    SemaphoreHandle_t mutex = __atomic_load_n(&s_info_mutex, __ATOMIC_ACQUIRE);
+    if (!mutex) return ESP_ERR_INVALID_STATE;
+
+    // The body is already JSON, so it is embedded as is
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (s_body_len == 0) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        int n = snprintf(out, out_size, "{\"type\":\"info\",\"info\":%s}",
+                         s_body);
+        if (n < 0 || (size_t)n >= out_size) err = ESP_ERR_INVALID_SIZE;
+    }
+    xSemaphoreGive(mutex);
+    return err;
+}
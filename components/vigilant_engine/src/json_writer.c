@@ -0,0 +1,233 @@
+#include "json_writer.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+void json_writer_init(json_writer_t* w, char* buf, size_t cap,
+                      json_writer_flush_fn flush, void* ctx) {
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    w->flush = flush;
+    w->ctx = ctx;
+    w->err = buf && cap ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t httpd_flush(void* ctx, const char* data, size_t len,
+                             bool final) {
+    httpd_req_t* req = (httpd_req_t*)ctx;
+    esp_err_t err = ESP_OK;
+    if (len > 0) {
+        err = httpd_resp_send_chunk(req, data, (ssize_t)len);
+    }
+    if (err == ESP_OK && final) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+void json_writer_init_httpd(json_writer_t* w, httpd_req_t* req, char* buf,
+                            size_t cap) {
+    json_writer_init(w, buf, cap, httpd_flush, req);
+}
+
+static void flush_buffer(json_writer_t* w) {
+    if (w->err != ESP_OK) return;
+    if (!w->flush) {
+        w->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    w->err = w->flush(w->ctx, w->buf, w->len, false);
+    w->len = 0;
+}
+
+static void put_char(json_writer_t* w, char c) {
+    if (w->len == w->cap) {
+        flush_buffer(w);
+    }
+    if (w->err != ESP_OK) return;
+    w->buf[w->len++] = c;
+}
+
+static void put_raw(json_writer_t* w, const char* s, size_t n) {
+    while (n > 0 && w->err == ESP_OK) {
+        if (w->len == w->cap) {
+            flush_buffer(w);
+            continue;
+        }
+        size_t room = w->cap - w->len;
+        size_t take = n < room ? n : room;
+        memcpy(w->buf + w->len, s, take);
+        w->len += take;
+        s += take;
+        n -= take;
+    }
+}
+
+// Comma handling for the value that is about to be written.
+static void begin_value(json_writer_t* w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+}
+
+static void put_escaped(json_writer_t* w, const char* s) {
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    while (*s && w->err == ESP_OK) {
+        // Copy runs that need no escaping in one go
+        const char* run = s;
+        while (*s && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20) {
+            ++s;
+        }
+        put_raw(w, run, (size_t)(s - run));
+        if (!*s) break;
+
+        unsigned char c = (unsigned char)*s++;
+        switch (c) {
+            case '"':
+                put_raw(w, "\\\"", 2);
+                break;
+            case '\\':
+                put_raw(w, "\\\\", 2);
+                break;
+            case '\n':
+                put_raw(w, "\\n", 2);
+                break;
+            case '\r':
+                put_raw(w, "\\r", 2);
+                break;
+            case '\t':
+                put_raw(w, "\\t", 2);
+                break;
+            default: {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                put_raw(w, esc, sizeof(esc));
+                break;
+            }
+        }
+    }
+    put_char(w, '"');
+}
+
+static void open_container(json_writer_t* w, char c) {
+    begin_value(w);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        if (w->err == ESP_OK) w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    put_char(w, c);
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_container(json_writer_t* w, char c) {
+    if (w->depth == 0) {
+        if (w->err == ESP_OK) w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+void json_writer_object_begin(json_writer_t* w) { open_container(w, '{'); }
+
+void json_writer_object_end(json_writer_t* w) { close_container(w, '}'); }
+
+void json_writer_array_begin(json_writer_t* w) { open_container(w, '['); }
+
+void json_writer_array_end(json_writer_t* w) { close_container(w, ']'); }
+
+void json_writer_key(json_writer_t* w, const char* key) {
+    begin_value(w);
+    put_escaped(w, key);
+    put_char(w, ':');
+    w->after_key = true;
+}
+
+void json_writer_string(json_writer_t* w, const char* s) {
+    begin_value(w);
+    if (s) {
+        put_escaped(w, s);
+    } else {
+        put_raw(w, "null", 4);
+    }
+}
+
+void json_writer_stringf(json_writer_t* w, const char* fmt, ...) {
+    char tmp[JSON_WRITER_STRINGF_MAX + 1];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        if (w->err == ESP_OK) w->err = ESP_ERR_INVALID_SIZE;
+        return;
+    }
+    json_writer_string(w, tmp);
+}
+
+void json_writer_int(json_writer_t* w, int64_t v) {
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%" PRId64, v);
+    begin_value(w);
+    put_raw(w, tmp, (size_t)n);
+}
+
+void json_writer_uint(json_writer_t* w, uint64_t v) {
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%" PRIu64, v);
+    begin_value(w);
+    put_raw(w, tmp, (size_t)n);
+}
+
+void json_writer_bool(json_writer_t* w, bool v) {
+    begin_value(w);
+    put_raw(w, v ? "true" : "false", v ? 4 : 5);
+}
+
+void json_writer_null(json_writer_t* w) {
+    begin_value(w);
+    put_raw(w, "null", 4);
+}
+
+void json_writer_kv_string(json_writer_t* w, const char* key, const char* s) {
+    json_writer_key(w, key);
+    json_writer_string(w, s);
+}
+
+void json_writer_kv_int(json_writer_t* w, const char* key, int64_t v) {
+    json_writer_key(w, key);
+    json_writer_int(w, v);
+}
+
+void json_writer_kv_uint(json_writer_t* w, const char* key, uint64_t v) {
+    json_writer_key(w, key);
+    json_writer_uint(w, v);
+}
+
+void json_writer_kv_bool(json_writer_t* w, const char* key, bool v) {
+    json_writer_key(w, key);
+    json_writer_bool(w, v);
+}
+
+esp_err_t json_writer_finish(json_writer_t* w) {
+    if (w->err != ESP_OK) return w->err;
+
+    if (w->flush) {
+        w->err = w->flush(w->ctx, w->buf, w->len, true);
+        w->len = 0;
+    } else if (w->len < w->cap) {
+        w->buf[w->len] = '\0';
+    }
+    return w->err;
+}
@@ -0,0 +1,47 @@
+#include "latency_hist.h"
+
+void latency_hist_record(latency_hist_t* h, uint32_t us) {
+    size_t i = 0;
+    if (us > LATENCY_HIST_MIN_US) {
+        i = (size_t)(32 - __builtin_clz(us - 1)) - LATENCY_HIST_MIN_SHIFT;
+        if (i >= LATENCY_HIST_BUCKETS) i = LATENCY_HIST_BUCKETS - 1;
+    }
+    __atomic_fetch_add(&h->buckets[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_us, us, __ATOMIC_RELAXED);
+
+    // A racing update can lose a max; it is a statistic, not an invariant
+    if (us > __atomic_load_n(&h->max_us, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&h->max_us, us, __ATOMIC_RELAXED);
+    }
+}
+
+uint32_t latency_hist_bucket_bound(size_t i) {
+    return i < LATENCY_HIST_BUCKETS - 1 ? LATENCY_HIST_MIN_US << i
+                                        : UINT32_MAX;
+}
+
+uint32_t latency_hist_count(const latency_hist_t* h) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; ++i) {
+        total += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t* h, uint32_t total,
+                                 uint32_t pct) {
+    uint32_t max_us = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+    if (total == 0) return 0;
+
+    uint64_t rank = ((uint64_t)total * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS - 1; ++i) {
+        seen += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            uint32_t bound = latency_hist_bucket_bound(i);
+            return bound < max_us ? bound : max_us;
+        }
+    }
+    return max_us;
+}
@@ -0,0 +1,213 @@
+#include "log_bench.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_server.h"
+#include "json_writer.h"
+#include "log_capture.h"
+
+static const char* TAG_BENCH = "ve_log_bench";
+
+#define LOG_BENCH_MAX_LINES 20000
+// The mutex path copies every line into one slot; the slot count only sets
+// the memory used, not the cost per line
+#define LOG_BENCH_MUTEX_SLOTS 16
+
+typedef enum {
+    LOG_BENCH_MUTEX,  // format, then copy under a mutex (the original path)
+    LOG_BENCH_RING,   // log_capture_vpush()
+    LOG_BENCH_MODES,
+} log_bench_mode_t;
+
+static const char* const s_mode_names[LOG_BENCH_MODES] = {
+    "mutex",
+    "ring",
+};
+
+typedef struct {
+    SemaphoreHandle_t mutex;
+    char (*lines)[LOG_LINE_MAX];
+    size_t head;
+} log_bench_mutex_ring_t;
+
+typedef struct {
+    log_bench_mode_t mode;
+    log_bench_mutex_ring_t* mutex_ring;
+    uint32_t lines;
+    int core;
+    TaskHandle_t waiter;
+    uint32_t dropped;
+    int64_t max_us;
+} log_bench_producer_t;
+
+static bool mutex_vpush(log_bench_mutex_ring_t* r, const char* fmt,
+                        va_list ap) {
+    char line[LOG_LINE_MAX];
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    if (len <= 0) return false;
+    if ((size_t)len >= sizeof(line)) len = sizeof(line) - 1;
+    if (line[len - 1] == '\n') line[len - 1] = '\0';
+
+    xSemaphoreTake(r->mutex, portMAX_DELAY);
+    strncpy(r->lines[r->head], line, LOG_LINE_MAX - 1);
+    r->lines[r->head][LOG_LINE_MAX - 1] = '\0';
+    r->head = (r->head + 1) % LOG_BENCH_MUTEX_SLOTS;
+    xSemaphoreGive(r->mutex);
+    return true;
+}
+
+static bool bench_push(log_bench_producer_t* p, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    bool ok = p->mode == LOG_BENCH_RING
+                  ? log_capture_vpush(fmt, ap)
+                  : mutex_vpush(p->mutex_ring, fmt, ap);
+    va_end(ap);
+    return ok;
+}
+
+static void producer_task(void* arg) {
+    log_bench_producer_t* p = (log_bench_producer_t*)arg;
+    // Start together with the producer on the other core
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (uint32_t i = 0; i < p->lines; ++i) {
+        int64_t start = esp_timer_get_time();
+        bool ok = bench_push(p, "I (%lu) ve_log_bench: core %d line %lu\n",
+                             (unsigned long)(start / 1000), p->core,
+                             (unsigned long)i);
+        int64_t us = esp_timer_get_time() - start;
+        if (us > p->max_us) p->max_us = us;
+        p->dropped += !ok;
+    }
+    xTaskNotifyGive(p->waiter);
+    vTaskDelete(NULL);
+}
+
+// Runs one producer per core and returns the time until the last one is done,
+// or -1 if a producer could not be started.
+static int64_t bench_run(log_bench_producer_t* producers, int count) {
+    TaskHandle_t tasks[portNUM_PROCESSORS];
+    for (int i = 0; i < count; ++i) {
+        if (xTaskCreatePinnedToCore(producer_task, "ve_logbench", 3072,
+                                    &producers[i], uxTaskPriorityGet(NULL),
+                                    &tasks[i], producers[i].core) != pdPASS) {
+            // The started ones wait for their start signal; release them
+            for (int j = 0; j < i; ++j) vTaskDelete(tasks[j]);
+            return -1;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < count; ++i) xTaskNotifyGive(tasks[i]);
+    for (int i = 0; i < count; ++i) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    return esp_timer_get_time() - start;
+}
+
+static uint32_t query_uint(const char* query, const char* key, uint32_t def,
+                           uint32_t min, uint32_t max) {
+    char value[12];
+    if (!query ||
+        httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return def;
+    }
+    unsigned long v = strtoul(value, NULL, 0);
+    return v < min ? min : v > max ? max : (uint32_t)v;
+}
+
+static esp_err_t logbench_get_handler(httpd_req_t* req) {
+    char query[32];
+    const char* q =
+        httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+            ? query
+            : NULL;
+    uint32_t lines = query_uint(q, "lines", 2000, 1, LOG_BENCH_MAX_LINES);
+
+    log_bench_mutex_ring_t mutex_ring = {
+        .mutex = xSemaphoreCreateMutex(),
+        .lines = calloc(LOG_BENCH_MUTEX_SLOTS, LOG_LINE_MAX),
+    };
+    if (!mutex_ring.mutex || !mutex_ring.lines) {
+        if (mutex_ring.mutex) vSemaphoreDelete(mutex_ring.mutex);
+        free(mutex_ring.lines);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Out of memory");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    char buf[JSON_WRITER_HTTP_BUF];
+    json_writer_t w;
+    json_writer_init_httpd(&w, req, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_kv_uint(&w, "lines", lines);
+    json_writer_kv_uint(&w, "producers", portNUM_PROCESSORS);
+    json_writer_key(&w, "results");
+    json_writer_array_begin(&w);
+    for (int mode = 0; mode < LOG_BENCH_MODES; ++mode) {
+        log_bench_producer_t producers[portNUM_PROCESSORS];
+        for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+            producers[core] = (log_bench_producer_t){
+                .mode = (log_bench_mode_t)mode,
+                .mutex_ring = &mutex_ring,
+                .lines = lines,
+                .core = core,
+                .waiter = xTaskGetCurrentTaskHandle(),
+            };
+        }
+        int64_t us = bench_run(producers, portNUM_PROCESSORS);
+        if (us < 0) {
+            ESP_LOGE(TAG_BENCH, "Could not start the producer tasks");
+            break;
+        }
+
+        uint32_t dropped = 0;
+        int64_t max_us = 0;
+        for (int i = 0; i < portNUM_PROCESSORS; ++i) {
+            dropped += producers[i].dropped;
+            if (producers[i].max_us > max_us) max_us = producers[i].max_us;
+        }
+        uint64_t total = (uint64_t)lines * portNUM_PROCESSORS;
+
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "mode", s_mode_names[mode]);
+        json_writer_kv_uint(&w, "lines", total);
+        json_writer_kv_uint(&w, "dropped", dropped);
+        json_writer_kv_uint(&w, "us", (uint64_t)us);
+        json_writer_kv_uint(&w, "per_second",
+                            us > 0 ? total * 1000000 / (uint64_t)us : 0);
+        json_writer_kv_uint(&w, "max_push_us", (uint64_t)max_us);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    esp_err_t err = json_writer_finish(&w);
+
+    vSemaphoreDelete(mutex_ring.mutex);
+    free(mutex_ring.lines);
+    return err;
+}
+
+esp_err_t log_bench_register_handlers(httpd_handle_t server) {
+    static const httpd_uri_t logbench_uri = {
+        .uri = "/logbench",
+        .method = HTTP_GET,
+        .handler = logbench_get_handler,
+        .user_ctx = NULL,
+    };
+
+    // Waits for the producer tasks; run it on a worker
+    esp_err_t err = http_server_register_async_uri(server, &logbench_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_BENCH, "Failed to register /logbench handler (%s)",
+                 esp_err_to_name(err));
+    }
+    return err;
+}
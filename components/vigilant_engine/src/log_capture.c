@@ -0,0 +1,745 @@
+#include "log_capture.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#if CONFIG_VE_LOG_DEFERRED_FORMAT && !CONFIG_IDF_TARGET_LINUX
+#include "esp_memory_utils.h"
+#endif
+
+// Every slot carries the sequence number of the line it holds, shifted left by
+// one. The low bit marks a producer that is still copying into the slot. This
+// lets readers detect torn or overwritten lines (seqlock) and lets producers
+// claim slots with a single CAS instead of taking a mutex.
+#define SLOT_BUSY 1u
+#define SEQ_TAG_MASK 0x7FFFFFFFu
+
+#if CONFIG_VE_LOG_DEFERRED_FORMAT
+// Packed argument words of one record. Sized so a slot is 128 bytes on the
+// 32-bit targets, compared to 272 bytes for a preformatted line.
+#define LOG_SLOT_DATA_BYTES 108
+#else
+#define LOG_SLOT_DATA_BYTES LOG_LINE_MAX
+#endif
+
+typedef struct {
+    _Atomic uint32_t state;
+    _Atomic uint32_t dropped_seq;  // last sequence that skipped this slot
+#if CONFIG_VE_LOG_DEFERRED_FORMAT
+    const char* fmt;  // NULL if data holds preformatted text
+#endif
+    uint32_t tag_hash;
+    uint16_t len;
+    uint8_t level;
+    char data[LOG_SLOT_DATA_BYTES];
+} log_slot_t;
+
+static log_slot_t s_slots[LOG_HISTORY_LINES];
+static _Atomic uint32_t s_next_seq = 1;
+static _Atomic uint32_t s_dropped = 0;
+
+static inline uint32_t seq_tag(uint32_t seq) { return seq & SEQ_TAG_MASK; }
+
+static inline uint32_t slot_state(uint32_t seq, bool busy) {
+    return (seq_tag(seq) << 1) | (busy ? SLOT_BUSY : 0u);
+}
+
+// True if tag `a` was assigned after tag `b` (31-bit serial arithmetic).
+static inline bool tag_is_newer(uint32_t a, uint32_t b) {
+    uint32_t diff = (a - b) & SEQ_TAG_MASK;
+    return diff != 0 && diff < (SEQ_TAG_MASK >> 1);
+}
+
+static inline log_slot_t* slot_for(uint32_t seq) {
+    return &s_slots[seq % LOG_HISTORY_LINES];
+}
+
+// Hands out the next sequence number and claims its slot. Returns NULL if the
+// line has to be dropped.
+static log_slot_t* slot_claim(uint32_t* seq_out) {
+    uint32_t seq =
+        atomic_fetch_add_explicit(&s_next_seq, 1, memory_order_relaxed);
+    log_slot_t* slot = slot_for(seq);
+
+    // A producer that got preempted for a whole lap of the ring may still own
+    // this slot, or a newer producer may already have filled it. Never wait
+    // for either: drop this line and leave a marker for readers instead.
+    uint32_t state = atomic_load_explicit(&slot->state, memory_order_relaxed);
+    if ((state & SLOT_BUSY) || tag_is_newer(state >> 1, seq_tag(seq)) ||
+        !atomic_compare_exchange_strong_explicit(
+            &slot->state, &state, slot_state(seq, true), memory_order_relaxed,
+            memory_order_relaxed)) {
+        atomic_store_explicit(&slot->dropped_seq, seq, memory_order_release);
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_release);
+
+    *seq_out = seq;
+    return slot;
+}
+
+static void slot_commit(log_slot_t* slot, uint32_t seq) {
+    atomic_store_explicit(&slot->state, slot_state(seq, false),
+                          memory_order_release);
+}
+
+static void slot_store_text(log_slot_t* slot, const char* text) {
+    size_t len = text ? strnlen(text, LOG_SLOT_DATA_BYTES - 1) : 0;
+    if (len > 0) {
+        memcpy(slot->data, text, len);
+    }
+    slot->data[len] = '\0';
+    slot->len = (uint16_t)len;
+#if CONFIG_VE_LOG_DEFERRED_FORMAT
+    slot->fmt = NULL;
+#endif
+}
+
+static uint32_t tag_hash_n(const char* tag, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)tag[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1u;
+}
+
+uint32_t log_capture_tag_hash(const char* tag) {
+    return tag && *tag ? tag_hash_n(tag, strlen(tag)) : 0;
+}
+
+static const char* skip_color(const char* s) {
+    if (s[0] == '\033' && s[1] == '[') {
+        const char* m = strchr(s, 'm');
+        if (m) return m + 1;
+    }
+    return s;
+}
+
+static uint8_t level_from_letter(char c) {
+    switch (c) {
+        case 'E':
+            return 1;  // ESP_LOG_ERROR
+        case 'W':
+            return 2;
+        case 'I':
+            return 3;
+        case 'D':
+            return 4;
+        case 'V':
+            return 5;  // ESP_LOG_VERBOSE
+        default:
+            return 0;
+    }
+}
+
+// Reads level and tag from a formatted esp_log line:
+// "<color>W (1234) tag: message".
+static void meta_from_text(const char* line, log_capture_meta_t* meta) {
+    meta->level = 0;
+    meta->tag_hash = 0;
+    if (!line) return;
+
+    const char* p = skip_color(line);
+    uint8_t level = level_from_letter(p[0]);
+    if (!level || p[1] != ' ' || p[2] != '(') return;
+
+    const char* close = strchr(p + 3, ')');
+    if (!close || close[1] != ' ') return;
+    const char* tag = close + 2;
+    const char* colon = strstr(tag, ": ");
+    if (!colon) return;
+
+    meta->level = level;
+    meta->tag_hash = tag_hash_n(tag, (size_t)(colon - tag));
+}
+
+static void slot_store_meta(log_slot_t* slot, const log_capture_meta_t* meta) {
+    slot->level = meta->level;
+    slot->tag_hash = meta->tag_hash;
+}
+
+static void strip_trailing_newline(char* line) {
+    size_t len = strlen(line);
+    if (len && line[len - 1] == '\n') {
+        line[len - 1] = '\0';
+    }
+}
+
+bool log_capture_push(const char* line) {
+    uint32_t seq = 0;
+    log_slot_t* slot = slot_claim(&seq);
+    if (!slot) {
+        return false;
+    }
+
+    log_capture_meta_t meta;
+    meta_from_text(line, &meta);
+    slot_store_meta(slot, &meta);
+    slot_store_text(slot, line);
+    slot_commit(slot, seq);
+    return true;
+}
+
+#if CONFIG_VE_LOG_DEFERRED_FORMAT
+
+typedef enum {
+    ARG_NONE,  // "%%"
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SIZE,
+    ARG_PTR,
+    ARG_DOUBLE,
+    ARG_STR,
+    ARG_UNSUPPORTED,
+} arg_kind_t;
+
+typedef struct {
+    const char* start;  // points at '%'
+    const char* end;    // one past the conversion character
+    bool width_star;
+    bool prec_star;
+    arg_kind_t kind;
+} fmt_spec_t;
+
+// Inline strings are stored as a length byte followed by the bytes. Strings in
+// flash are stored as a pointer behind this marker instead of being copied.
+#define STR_REF_MARKER 0xFF
+#define STR_INLINE_MAX 0xFE
+
+// Parses one printf conversion starting at `p` (which points at '%').
+static void parse_spec(const char* p, fmt_spec_t* spec) {
+    const char* q = p + 1;
+    spec->start = p;
+    spec->width_star = false;
+    spec->prec_star = false;
+
+    if (*q == '%') {
+        spec->kind = ARG_NONE;
+        spec->end = q + 1;
+        return;
+    }
+
+    while (*q && strchr("-+ #0", *q)) {
+        q++;
+    }
+    if (*q == '*') {
+        spec->width_star = true;
+        q++;
+    } else {
+        while (*q >= '0' && *q <= '9') q++;
+    }
+    if (*q == '.') {
+        q++;
+        if (*q == '*') {
+            spec->prec_star = true;
+            q++;
+        } else {
+            while (*q >= '0' && *q <= '9') q++;
+        }
+    }
+
+    int longs = 0;
+    bool size_mod = false;
+    bool intmax_mod = false;
+    bool long_double = false;
+    while (*q && strchr("hljztLq", *q)) {
+        if (*q == 'l') longs++;
+        if (*q == 'q') longs = 2;
+        if (*q == 'z' || *q == 't') size_mod = true;
+        if (*q == 'j') intmax_mod = true;
+        if (*q == 'L') long_double = true;
+        q++;
+    }
+
+    char conv = *q;
+    spec->end = conv ? q + 1 : q;
+    switch (conv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (conv == 'c' && longs) {
+                spec->kind = ARG_UNSUPPORTED;  // wint_t
+            } else if (size_mod) {
+                spec->kind = ARG_SIZE;
+            } else if (intmax_mod) {
+                spec->kind = ARG_INTMAX;
+            } else if (longs >= 2) {
+                spec->kind = ARG_LLONG;
+            } else if (longs == 1) {
+                spec->kind = ARG_LONG;
+            } else {
+                spec->kind = ARG_INT;
+            }
+            break;
+        case 'p':
+            spec->kind = ARG_PTR;
+            break;
+        case 's':
+            spec->kind = longs ? ARG_UNSUPPORTED : ARG_STR;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->kind = long_double ? ARG_UNSUPPORTED : ARG_DOUBLE;
+            break;
+        default:
+            spec->kind = ARG_UNSUPPORTED;  // %n, wide chars, truncated spec
+            break;
+    }
+}
+
+static bool put_bytes(log_slot_t* slot, size_t* pos, const void* src,
+                      size_t len) {
+    if (*pos + len > LOG_SLOT_DATA_BYTES) {
+        return false;
+    }
+    memcpy(slot->data + *pos, src, len);
+    *pos += len;
+    return true;
+}
+
+// Only pointers into flash outlive the log call, everything else is copied.
+static bool str_is_static(const char* s) {
+#if CONFIG_IDF_TARGET_LINUX
+    (void)s;
+    return false;
+#else
+    return esp_ptr_in_drom(s);
+#endif
+}
+
+static bool fmt_is_static(const char* fmt) {
+#if CONFIG_IDF_TARGET_LINUX
+    return fmt != NULL;  // esp_log formats are always string literals
+#else
+    return fmt && esp_ptr_in_drom(fmt);
+#endif
+}
+
+static bool put_str(log_slot_t* slot, size_t* pos, const char* s) {
+    if (s && str_is_static(s)) {
+        uint8_t marker = STR_REF_MARKER;
+        return put_bytes(slot, pos, &marker, 1) &&
+               put_bytes(slot, pos, &s, sizeof(s));
+    }
+
+    if (!s) {
+        s = "(null)";
+    }
+    if (*pos >= LOG_SLOT_DATA_BYTES) {
+        return false;
+    }
+    // Truncate long strings to what is left in the record
+    size_t room = LOG_SLOT_DATA_BYTES - *pos - 1;
+    if (room > STR_INLINE_MAX) {
+        room = STR_INLINE_MAX;
+    }
+    uint8_t len = (uint8_t)strnlen(s, room);
+    return put_bytes(slot, pos, &len, 1) && put_bytes(slot, pos, s, len);
+}
+
+// Captures the raw argument words for `fmt`. Returns false if the format uses
+// a conversion we cannot defer or the arguments do not fit into the record.
+static bool record_encode(log_slot_t* slot, const char* fmt, va_list ap) {
+    size_t pos = 0;
+    fmt_spec_t spec;
+
+    for (const char* p = strchr(fmt, '%'); p; p = strchr(spec.end, '%')) {
+        parse_spec(p, &spec);
+        if (spec.kind == ARG_UNSUPPORTED) {
+            return false;
+        }
+        if (spec.width_star) {
+            int width = va_arg(ap, int);
+            if (!put_bytes(slot, &pos, &width, sizeof(width))) return false;
+        }
+        if (spec.prec_star) {
+            int prec = va_arg(ap, int);
+            if (!put_bytes(slot, &pos, &prec, sizeof(prec))) return false;
+        }
+
+        bool ok = true;
+        switch (spec.kind) {
+            case ARG_INT: {
+                int v = va_arg(ap, int);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_LONG: {
+                long v = va_arg(ap, long);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_LLONG: {
+                long long v = va_arg(ap, long long);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_INTMAX: {
+                intmax_t v = va_arg(ap, intmax_t);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v = va_arg(ap, size_t);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_PTR: {
+                void* v = va_arg(ap, void*);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v = va_arg(ap, double);
+                ok = put_bytes(slot, &pos, &v, sizeof(v));
+                break;
+            }
+            case ARG_STR:
+                ok = put_str(slot, &pos, va_arg(ap, const char*));
+                break;
+            default:
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    slot->fmt = fmt;
+    slot->len = (uint16_t)pos;
+    return true;
+}
+
+static bool get_bytes(const log_slot_t* slot, size_t* pos, void* dst,
+                      size_t len) {
+    if (*pos + len > slot->len) {
+        return false;
+    }
+    memcpy(dst, slot->data + *pos, len);
+    *pos += len;
+    return true;
+}
+
+// Appends `src[0..len)` to out, keeping it null-terminated.
+static void out_append(char* out, size_t out_size, size_t* used,
+                       const char* src, size_t len) {
+    if (*used + 1 >= out_size) {
+        return;
+    }
+    size_t room = out_size - 1 - *used;
+    if (len > room) {
+        len = room;
+    }
+    memcpy(out + *used, src, len);
+    *used += len;
+    out[*used] = '\0';
+}
+
+// Rebuilds the text for a deferred record by formatting one conversion at a
+// time with the captured argument words.
+static void record_format(const log_slot_t* slot, char* out,
+                          size_t out_size) {
+    size_t used = 0;
+    size_t pos = 0;
+    const char* fmt = slot->fmt;
+    fmt_spec_t spec;
+
+    out[0] = '\0';
+    for (const char* p = fmt; *p;) {
+        const char* pct = strchr(p, '%');
+        if (!pct) {
+            out_append(out, out_size, &used, p, strlen(p));
+            break;
+        }
+        out_append(out, out_size, &used, p, (size_t)(pct - p));
+        parse_spec(pct, &spec);
+        p = spec.end;
+
+        if (spec.kind == ARG_NONE) {
+            out_append(out, out_size, &used, "%", 1);
+            continue;
+        }
+
+        // Rebuild the conversion with '*' replaced by the captured value
+        char conv[32];
+        size_t conv_len = 0;
+        for (const char* c = spec.start; c < spec.end; ++c) {
+            if (*c == '*') {
+                int star = 0;
+                if (!get_bytes(slot, &pos, &star, sizeof(star))) return;
+                conv_len += (size_t)snprintf(conv + conv_len,
+                                             sizeof(conv) - conv_len, "%d",
+                                             star);
+            } else if (conv_len + 1 < sizeof(conv)) {
+                conv[conv_len++] = *c;
+            }
+            if (conv_len >= sizeof(conv)) return;
+        }
+        conv[conv_len] = '\0';
+
+        char* dst = out + used;
+        size_t room = out_size - used;
+        int written = 0;
+        switch (spec.kind) {
+            case ARG_INT: {
+                int v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_LONG: {
+                long v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_LLONG: {
+                long long v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_INTMAX: {
+                intmax_t v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_PTR: {
+                void* v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v;
+                if (!get_bytes(slot, &pos, &v, sizeof(v))) return;
+                written = snprintf(dst, room, conv, v);
+                break;
+            }
+            case ARG_STR: {
+                uint8_t len;
+                if (!get_bytes(slot, &pos, &len, 1)) return;
+                if (len == STR_REF_MARKER) {
+                    const char* s;
+                    if (!get_bytes(slot, &pos, &s, sizeof(s))) return;
+                    written = snprintf(dst, room, conv, s);
+                } else {
+                    char s[LOG_SLOT_DATA_BYTES];
+                    if (!get_bytes(slot, &pos, s, len)) return;
+                    s[len] = '\0';
+                    written = snprintf(dst, room, conv, s);
+                }
+                break;
+            }
+            default:
+                return;
+        }
+
+        if (written < 0) {
+            return;
+        }
+        used += (size_t)written;
+        if (used >= out_size) {
+            return;  // truncated, snprintf already terminated the buffer
+        }
+    }
+}
+
+// Same as meta_from_text(), but taken from the esp_log format and its first
+// two arguments: "<color>W (%" PRIu32 ") %s: ..." with timestamp and tag, or
+// "(%s)" when the timestamp is a preformatted system time string.
+static void meta_from_format(const char* fmt, va_list ap,
+                             log_capture_meta_t* meta) {
+    meta->level = 0;
+    meta->tag_hash = 0;
+    if (!fmt) return;
+
+    const char* p = skip_color(fmt);
+    uint8_t level = level_from_letter(p[0]);
+    if (!level || strncmp(p + 1, " (%", 3) != 0) return;
+
+    p += 4;
+    const char* close = strchr(p, ')');
+    if (!close || close - p > 3 || strncmp(close, ") %s: ", 6) != 0) return;
+
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    if (*p == 's') {
+        (void)va_arg(ap_copy, const char*);
+    } else {
+        (void)va_arg(ap_copy, uint32_t);
+    }
+    const char* tag = va_arg(ap_copy, const char*);
+    va_end(ap_copy);
+
+    meta->level = level;
+    meta->tag_hash = log_capture_tag_hash(tag);
+}
+
+bool log_capture_vpush(const char* fmt, va_list ap) {
+    uint32_t seq = 0;
+    log_slot_t* slot = slot_claim(&seq);
+    if (!slot) {
+        return false;
+    }
+
+    log_capture_meta_t meta;
+    meta_from_format(fmt, ap, &meta);
+    slot_store_meta(slot, &meta);
+
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    bool deferred = fmt_is_static(fmt) && record_encode(slot, fmt, ap_copy);
+    va_end(ap_copy);
+
+    if (!deferred) {
+        // Fall back to eager formatting, truncated to the record size
+        char line[LOG_SLOT_DATA_BYTES];
+        va_copy(ap_copy, ap);
+        vsnprintf(line, sizeof(line), fmt ? fmt : "", ap_copy);
+        va_end(ap_copy);
+        strip_trailing_newline(line);
+        slot_store_text(slot, line);
+    }
+
+    slot_commit(slot, seq);
+    return true;
+}
+
+#else
+
+bool log_capture_vpush(const char* fmt, va_list ap) {
+    char line[LOG_LINE_MAX];
+
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    vsnprintf(line, sizeof(line), fmt, ap_copy);
+    va_end(ap_copy);
+
+    // Strip trailing newline to avoid double spacing on client
+    strip_trailing_newline(line);
+    return log_capture_push(line);
+}
+
+#endif  // CONFIG_VE_LOG_DEFERRED_FORMAT
+
+uint32_t log_capture_next_seq(void) {
+    return atomic_load_explicit(&s_next_seq, memory_order_acquire);
+}
+
+uint32_t log_capture_oldest_seq(void) {
+    uint32_t next = log_capture_next_seq();
+    uint32_t pushed = next - 1u;
+    return pushed < LOG_HISTORY_LINES ? 1u : next - LOG_HISTORY_LINES;
+}
+
+log_capture_result_t log_capture_read(uint32_t seq, char* out,
+                                      size_t out_size,
+                                      log_capture_meta_t* meta) {
+    if (!out || out_size == 0) {
+        return LOG_CAPTURE_LOST;
+    }
+    out[0] = '\0';
+
+    log_capture_meta_t unused;
+    if (!meta) {
+        meta = &unused;
+    }
+    meta->level = 0;
+    meta->tag_hash = 0;
+
+    uint32_t ahead = log_capture_next_seq() - seq;
+    if (ahead == 0 || ahead > (SEQ_TAG_MASK >> 1)) {
+        return LOG_CAPTURE_PENDING;  // not handed out to a producer yet
+    }
+    if (ahead > LOG_HISTORY_LINES) {
+        return LOG_CAPTURE_LOST;
+    }
+
+    log_slot_t* slot = slot_for(seq);
+    uint32_t before = atomic_load_explicit(&slot->state, memory_order_acquire);
+    if (before != slot_state(seq, false)) {
+        if (atomic_load_explicit(&slot->dropped_seq, memory_order_acquire) ==
+                seq ||
+            tag_is_newer(before >> 1, seq_tag(seq))) {
+            return LOG_CAPTURE_LOST;
+        }
+        return LOG_CAPTURE_PENDING;  // producer is still copying
+    }
+
+    uint8_t level = slot->level;
+    uint32_t tag_hash = slot->tag_hash;
+
+#if CONFIG_VE_LOG_DEFERRED_FORMAT
+    // Snapshot the record first; formatting from a slot that is being
+    // overwritten could walk a half-written argument block.
+    log_slot_t copy;
+    copy.fmt = slot->fmt;
+    copy.len = slot->len;
+    if (copy.len > LOG_SLOT_DATA_BYTES) {
+        copy.len = LOG_SLOT_DATA_BYTES;
+    }
+    memcpy(copy.data, slot->data, copy.len);
+#else
+    size_t len = slot->len;
+    if (len >= out_size) {
+        len = out_size - 1;
+    }
+    memcpy(out, slot->data, len);
+    out[len] = '\0';
+#endif
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->state, memory_order_relaxed) != before) {
+        out[0] = '\0';
+        return LOG_CAPTURE_LOST;  // overwritten while we were copying
+    }
+
+    meta->level = level;
+    meta->tag_hash = tag_hash;
+
+#if CONFIG_VE_LOG_DEFERRED_FORMAT
+    if (copy.fmt) {
+        record_format(&copy, out, out_size);
+        strip_trailing_newline(out);
+    } else {
+        size_t len = copy.len < out_size ? copy.len : out_size - 1;
+        memcpy(out, copy.data, len);
+        out[len] = '\0';
+    }
+#endif
+
+    return LOG_CAPTURE_OK;
+}
+
+uint32_t log_capture_dropped(void) {
+    return atomic_load_explicit(&s_dropped, memory_order_relaxed);
+}
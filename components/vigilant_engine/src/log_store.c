@@ -0,0 +1,643 @@
+#include "log_store.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_server.h"
+#include "log_capture.h"
+#include "sdkconfig.h"
+
+static const char* TAG_STORE = "log_store";
+
+// The partition is an append-only ring of 4 KB sectors. Each sector starts
+// with a header carrying a generation number that increases every time a
+// sector is erased, so the newest sector is found at boot without a separate
+// index. Records never cross a sector boundary; erased flash (0xFF) ends the
+// records of a sector.
+#define STORE_SECTOR_SIZE 4096
+#define STORE_PAGE_SIZE 256
+#define STORE_MAGIC 0x474F4C56u  // "VLOG"
+#define STORE_RECORD_MARK 0xA5
+#define STORE_TASK_STACK 4096
+#define STORE_TASK_PRIORITY 1
+#define STORE_LOCK_TIMEOUT_MS 100
+#define STORE_HTTP_CHUNK 512
+
+typedef struct {
+    uint32_t magic;
+    uint32_t gen;
+    uint32_t boot;  // boot that erased the sector
+    uint32_t reserved;
+} store_sector_hdr_t;
+
+typedef struct {
+    uint16_t len;  // text bytes after the header, 0xFFFF on erased flash
+    uint8_t mark;
+    uint8_t level;
+    uint32_t boot;
+    uint32_t seq;  // log_capture sequence number within the boot
+} store_record_hdr_t;
+
+// Position just past the last stored record.
+typedef struct {
+    uint32_t sector;
+    uint32_t offset;
+} store_pos_t;
+
+static const esp_partition_t* s_part = NULL;
+static uint32_t s_sector_count = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task = NULL;
+
+// Writer state, protected by s_lock
+static uint32_t s_head = 0;  // sector being appended to
+static uint32_t s_head_gen = 0;
+static uint32_t s_write_off = 0;  // next record offset in the head sector
+static uint8_t s_page[STORE_PAGE_SIZE];
+static uint32_t s_page_base = 0;     // sector offset of s_page[0]
+static uint32_t s_page_written = 0;  // bytes of s_page already in flash
+static int64_t s_last_flush_us = 0;
+static uint32_t s_boot = 1;
+static uint32_t s_cursor = 1;  // next capture sequence to store
+static uint32_t s_lost = 0;    // lines that left the ring before we got them
+
+static inline uint32_t align4(uint32_t n) { return (n + 3u) & ~3u; }
+
+static inline size_t sector_addr(uint32_t sector) {
+    return (size_t)sector * STORE_SECTOR_SIZE;
+}
+
+static bool read_sector_hdr(uint32_t sector, store_sector_hdr_t* hdr) {
+    return esp_partition_read(s_part, sector_addr(sector), hdr,
+                              sizeof(*hdr)) == ESP_OK &&
+           hdr->magic == STORE_MAGIC;
+}
+
+// Writes the part of the page buffer that is not in flash yet.
+static esp_err_t page_write_pending(void) {
+    uint32_t fill = s_write_off - s_page_base;
+    if (fill <= s_page_written) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = esp_partition_write(
+        s_part, sector_addr(s_head) + s_page_base + s_page_written,
+        s_page + s_page_written, fill - s_page_written);
+    s_page_written = fill;
+    s_last_flush_us = esp_timer_get_time();
+    return err;
+}
+
+// Points the page buffer at s_write_off; bytes before it are in flash.
+static void page_reset(void) {
+    s_page_base = s_write_off & ~(uint32_t)(STORE_PAGE_SIZE - 1);
+    s_page_written = s_write_off - s_page_base;
+    memset(s_page, 0xFF, sizeof(s_page));
+}
+
+static esp_err_t sector_start(uint32_t sector, uint32_t gen) {
+    esp_err_t err = esp_partition_erase_range(s_part, sector_addr(sector),
+                                              STORE_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    store_sector_hdr_t hdr = {
+        .magic = STORE_MAGIC,
+        .gen = gen,
+        .boot = s_boot,
+        .reserved = 0xFFFFFFFFu,
+    };
+    err = esp_partition_write(s_part, sector_addr(sector), &hdr, sizeof(hdr));
+    s_head = sector;
+    s_head_gen = gen;
+    s_write_off = sizeof(hdr);
+    page_reset();
+    return err;
+}
+
+static esp_err_t store_append(const void* data, uint32_t len) {
+    const uint8_t* src = (const uint8_t*)data;
+    while (len > 0) {
+        uint32_t fill = s_write_off - s_page_base;
+        uint32_t n = STORE_PAGE_SIZE - fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s_page + fill, src, n);
+        s_write_off += n;
+        src += n;
+        len -= n;
+
+        if (s_write_off - s_page_base == STORE_PAGE_SIZE) {
+            // Full pages go out as one aligned write
+            esp_err_t err = page_write_pending();
+            s_page_base += STORE_PAGE_SIZE;
+            s_page_written = 0;
+            memset(s_page, 0xFF, sizeof(s_page));
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t store_record(uint8_t level, uint32_t seq, const char* text) {
+    size_t text_len = strlen(text);
+    if (text_len > LOG_LINE_MAX - 1) {
+        text_len = LOG_LINE_MAX - 1;
+    }
+
+    uint32_t total = align4(sizeof(store_record_hdr_t) + (uint32_t)text_len);
+    if (s_write_off + total > STORE_SECTOR_SIZE) {
+        esp_err_t err = page_write_pending();
+        if (err == ESP_OK) {
+            err = sector_start((s_head + 1) % s_sector_count, s_head_gen + 1);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    store_record_hdr_t hdr = {
+        .len = (uint16_t)text_len,
+        .mark = STORE_RECORD_MARK,
+        .level = level,
+        .boot = s_boot,
+        .seq = seq,
+    };
+    static const uint8_t pad[3] = {0, 0, 0};
+    uint32_t pad_len = total - sizeof(hdr) - (uint32_t)text_len;
+
+    esp_err_t err = store_append(&hdr, sizeof(hdr));
+    if (err == ESP_OK) err = store_append(text, (uint32_t)text_len);
+    if (err == ESP_OK) err = store_append(pad, pad_len);
+    return err;
+}
+
+// Copies new lines from the capture ring into the page buffer. Caller holds
+// s_lock.
+static esp_err_t store_drain_ring(void) {
+    char line[LOG_LINE_MAX];
+    log_capture_meta_t meta;
+
+    uint32_t oldest = log_capture_oldest_seq();
+    if ((int32_t)(s_cursor - oldest) < 0) {
+        s_lost += oldest - s_cursor;
+        s_cursor = oldest;
+    }
+
+    while (s_cursor != log_capture_next_seq()) {
+        log_capture_result_t res =
+            log_capture_read(s_cursor, line, sizeof(line), &meta);
+        if (res == LOG_CAPTURE_PENDING) {
+            break;
+        }
+        if (res == LOG_CAPTURE_LOST) {
+            s_lost++;
+            s_cursor++;
+            continue;
+        }
+
+        if (s_lost > 0) {
+            char note[64];
+            snprintf(note, sizeof(note), "-- %" PRIu32 " log line(s) lost --",
+                     s_lost);
+            s_lost = 0;
+            esp_err_t err = store_record(0, s_cursor, note);
+            if (err != ESP_OK) return err;
+        }
+
+        esp_err_t err = store_record(meta.level, s_cursor, line);
+        if (err != ESP_OK) return err;
+        s_cursor++;
+    }
+    return ESP_OK;
+}
+
+static void log_store_task(void* arg) {
+    (void)arg;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_VE_LOG_FLASH_POLL_MS));
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        esp_err_t err = store_drain_ring();
+        // Partial pages are only written once they have waited long enough,
+        // so a slow trickle of lines still ends up in few flash writes.
+        if (err == ESP_OK &&
+            esp_timer_get_time() - s_last_flush_us >=
+                (int64_t)CONFIG_VE_LOG_FLASH_FLUSH_MS * 1000) {
+            err = page_write_pending();
+        }
+        xSemaphoreGive(s_lock);
+
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_STORE, "flash write failed: %s",
+                     esp_err_to_name(err));
+        }
+    }
+}
+
+esp_err_t log_store_flush(void) {
+    if (!s_part || !s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Bounded wait: this also runs from the shutdown handler, where the
+    // store task may have been preempted while holding the lock.
+    if (xSemaphoreTake(s_lock, pdMS_TO_TICKS(STORE_LOCK_TIMEOUT_MS)) !=
+        pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t err = store_drain_ring();
+    if (err == ESP_OK) {
+        err = page_write_pending();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static void log_store_shutdown(void) { log_store_flush(); }
+#endif
+
+// Finds the end of the records in `sector`. Returns false if the sector holds
+// a record that was cut off, e.g. by a power loss.
+static bool scan_sector_end(uint32_t sector, uint32_t* end,
+                            uint32_t* last_boot) {
+    uint32_t off = sizeof(store_sector_hdr_t);
+    while (off + sizeof(store_record_hdr_t) <= STORE_SECTOR_SIZE) {
+        store_record_hdr_t rec;
+        if (esp_partition_read(s_part, sector_addr(sector) + off, &rec,
+                               sizeof(rec)) != ESP_OK) {
+            return false;
+        }
+        if (rec.len == 0xFFFF) {
+            break;
+        }
+        uint32_t total = align4(sizeof(rec) + rec.len);
+        if (rec.mark != STORE_RECORD_MARK ||
+            off + total > STORE_SECTOR_SIZE) {
+            return false;
+        }
+        *last_boot = rec.boot;
+        off += total;
+    }
+    *end = off;
+    return true;
+}
+
+static esp_err_t store_mount(void) {
+    bool found = false;
+    uint32_t head = 0;
+    store_sector_hdr_t head_hdr = {0};
+
+    for (uint32_t i = 0; i < s_sector_count; ++i) {
+        store_sector_hdr_t hdr;
+        if (!read_sector_hdr(i, &hdr)) {
+            continue;
+        }
+        if (!found || (int32_t)(hdr.gen - head_hdr.gen) > 0) {
+            found = true;
+            head = i;
+            head_hdr = hdr;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG_STORE, "empty log partition, formatting");
+        s_boot = 1;
+        return sector_start(0, 1);
+    }
+
+    uint32_t last_boot = head_hdr.boot;
+    uint32_t end = 0;
+    bool clean = scan_sector_end(head, &end, &last_boot);
+    s_boot = last_boot + 1;
+    if (!clean) {
+        // Never append behind a torn record, continue in a fresh sector
+        return sector_start((head + 1) % s_sector_count, head_hdr.gen + 1);
+    }
+
+    s_head = head;
+    s_head_gen = head_hdr.gen;
+    s_write_off = end;
+    page_reset();
+    return ESP_OK;
+}
+
+esp_err_t log_store_init(void) {
+    if (s_part) {
+        return ESP_OK;
+    }
+
+    const esp_partition_t* part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                 ESP_PARTITION_SUBTYPE_ANY,
+                                 CONFIG_VE_LOG_FLASH_PARTITION);
+    if (!part) {
+        ESP_LOGW(TAG_STORE, "no '%s' partition, flash log disabled",
+                 CONFIG_VE_LOG_FLASH_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->size < 2 * STORE_SECTOR_SIZE) {
+        ESP_LOGE(TAG_STORE, "log partition too small: %" PRIu32,
+                 (uint32_t)part->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_part = part;
+    s_sector_count = part->size / STORE_SECTOR_SIZE;
+    esp_err_t err = store_mount();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_STORE, "mount failed: %s", esp_err_to_name(err));
+        s_part = NULL;
+        return err;
+    }
+    // Only lines from this boot that are still in the ring get stored
+    s_cursor = log_capture_oldest_seq();
+    s_last_flush_us = esp_timer_get_time();
+
+    if (xTaskCreate(log_store_task, "ve_log_store", STORE_TASK_STACK, NULL,
+                    STORE_TASK_PRIORITY, &s_task) != pdPASS) {
+        s_part = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    esp_register_shutdown_handler(log_store_shutdown);
+#endif
+    ESP_LOGI(TAG_STORE, "flash log: %" PRIu32 " sectors, boot %" PRIu32,
+             s_sector_count, s_boot);
+    return ESP_OK;
+}
+
+// Generation recorded for a sector without a valid header
+#define STORE_GEN_NONE 0xFFFFFFFFu
+
+// Output of GET /logs. Walks the stored text once to size it and once to send
+// it; only bytes inside [first, last] reach the client. The sizing walk
+// records the generation of every sector, and the sending walk stops at the
+// first sector that the writer has erased since, as the offsets no longer
+// match the announced size from there on.
+typedef struct {
+    httpd_req_t* req;  // NULL while sizing
+    uint32_t* gens;    // per sector, s_sector_count entries
+    bool changed;      // the sending walk stopped at an erased sector
+    uint32_t pos;
+    uint32_t first;
+    uint32_t last;
+    char buf[STORE_HTTP_CHUNK];
+    size_t len;
+    esp_err_t err;
+} store_out_t;
+
+static void out_write(store_out_t* out, const char* data, size_t len) {
+    uint32_t start = out->pos;
+    out->pos += (uint32_t)len;
+    if (!out->req || out->err != ESP_OK || out->pos <= out->first ||
+        start > out->last) {
+        return;
+    }
+
+    // Clip to the requested range
+    size_t skip = start < out->first ? out->first - start : 0;
+    size_t end = len;
+    if (out->pos - 1 > out->last) {
+        end = len - (out->pos - 1 - out->last);
+    }
+    for (size_t i = skip; i < end; ++i) {
+        out->buf[out->len++] = data[i];
+        if (out->len == sizeof(out->buf)) {
+            out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+            out->len = 0;
+            if (out->err != ESP_OK) return;
+        }
+    }
+}
+
+// Emits every stored record, oldest first, up to `end`.
+static void store_walk(store_pos_t end, store_out_t* out) {
+    uint32_t prev_boot = 0;
+    char text[LOG_LINE_MAX];
+
+    for (uint32_t n = 1; n <= s_sector_count; ++n) {
+        uint32_t sector = (end.sector + n) % s_sector_count;
+        store_sector_hdr_t hdr;
+        bool valid = read_sector_hdr(sector, &hdr);
+        uint32_t gen = valid ? hdr.gen : STORE_GEN_NONE;
+        if (!out->req) {
+            out->gens[sector] = gen;
+        } else if (out->gens[sector] != gen) {
+            out->changed = true;
+            return;
+        }
+        if (!valid) {
+            continue;
+        }
+
+        uint32_t limit =
+            sector == end.sector ? end.offset : STORE_SECTOR_SIZE;
+        uint32_t off = sizeof(hdr);
+        while (off + sizeof(store_record_hdr_t) <= limit) {
+            store_record_hdr_t rec;
+            if (esp_partition_read(s_part, sector_addr(sector) + off, &rec,
+                                   sizeof(rec)) != ESP_OK ||
+                rec.len == 0xFFFF || rec.mark != STORE_RECORD_MARK ||
+                rec.len >= sizeof(text)) {
+                break;
+            }
+            if (esp_partition_read(s_part,
+                                   sector_addr(sector) + off + sizeof(rec),
+                                   text, rec.len) != ESP_OK) {
+                break;
+            }
+
+            // The writer may have wrapped around onto this sector meanwhile
+            store_sector_hdr_t again;
+            if (!read_sector_hdr(sector, &again) || again.gen != hdr.gen) {
+                if (out->req) {
+                    out->changed = true;
+                    return;
+                }
+                break;
+            }
+
+            if (rec.boot != prev_boot) {
+                char marker[32];
+                int m = snprintf(marker, sizeof(marker),
+                                 "--- boot %" PRIu32 " ---\n", rec.boot);
+                out_write(out, marker, (size_t)m);
+                prev_boot = rec.boot;
+            }
+            out_write(out, text, rec.len);
+            out_write(out, "\n", 1);
+            off += align4(sizeof(rec) + rec.len);
+        }
+
+        if (sector == end.sector) {
+            break;
+        }
+    }
+}
+
+bool log_store_parse_range(const char* value, uint32_t total,
+                           uint32_t* first, uint32_t* last,
+                           bool* unsatisfiable) {
+    *unsatisfiable = false;
+    if (!value || strncmp(value, "bytes=", 6) != 0 || strchr(value, ',')) {
+        return false;
+    }
+
+    const char* spec = value + 6;
+    const char* dash = strchr(spec, '-');
+    if (!dash) {
+        return false;
+    }
+
+    char* endp = NULL;
+    if (dash == spec) {
+        unsigned long suffix = strtoul(dash + 1, &endp, 10);
+        if (endp == dash + 1 || suffix == 0) {
+            *unsatisfiable = true;
+            return true;
+        }
+        *first = suffix >= total ? 0 : total - (uint32_t)suffix;
+        *last = total - 1;
+    } else {
+        *first = (uint32_t)strtoul(spec, &endp, 10);
+        if (endp != dash) return false;
+        if (dash[1] == '\0') {
+            *last = total - 1;
+        } else {
+            *last = (uint32_t)strtoul(dash + 1, &endp, 10);
+            if (*endp != '\0' || *last < *first) return false;
+            if (*last >= total) *last = total - 1;
+        }
+    }
+    if (total == 0 || *first >= total) {
+        *unsatisfiable = true;
+    }
+    return true;
+}
+
+static esp_err_t logs_get_handler(httpd_req_t* req) {
+    // Push what is still buffered so the download includes the latest lines
+    log_store_flush();
+
+    store_pos_t end;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    end.sector = s_head;
+    end.offset = s_page_base + s_page_written;
+    xSemaphoreGive(s_lock);
+
+    store_out_t* out = (store_out_t*)calloc(1, sizeof(store_out_t));
+    uint32_t* gens = (uint32_t*)calloc(s_sector_count, sizeof(uint32_t));
+    if (!out || !gens) {
+        free(out);
+        free(gens);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Out of memory");
+    }
+    out->gens = gens;
+
+    // First pass only counts bytes
+    store_walk(end, out);
+    uint32_t total = out->pos;
+
+    uint32_t first = 0;
+    uint32_t last = total ? total - 1 : 0;
+    bool unsatisfiable = false;
+    char range[48];
+    bool ranged =
+        httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) ==
+            ESP_OK &&
+        log_store_parse_range(range, total, &first, &last, &unsatisfiable);
+
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    char content_range[48];
+    if (ranged && unsatisfiable) {
+        snprintf(content_range, sizeof(content_range), "bytes */%" PRIu32,
+                 total);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+        free(out);
+        free(gens);
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (ranged) {
+        snprintf(content_range, sizeof(content_range),
+                 "bytes %" PRIu32 "-%" PRIu32 "/%" PRIu32, first, last, total);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+    }
+
+    out->req = req;
+    out->pos = 0;
+    out->first = first;
+    out->last = total ? last : 0;
+    if (total > 0) {
+        store_walk(end, out);
+    }
+    if (out->err == ESP_OK && out->len > 0) {
+        out->err = httpd_resp_send_chunk(req, out->buf, out->len);
+    }
+    if (out->changed) {
+        // End the body where the old data ends; a ranged client sees fewer
+        // bytes than announced and can retry
+        uint32_t end_pos = out->pos < last + 1 ? out->pos : last + 1;
+        ESP_LOGW(TAG_STORE,
+                 "log wrapped during download, sent %" PRIu32 " of %" PRIu32
+                 " bytes",
+                 end_pos > first ? end_pos - first : 0, last - first + 1);
+    }
+    esp_err_t err = out->err;
+    free(out);
+    free(gens);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t log_store_register_handlers(httpd_handle_t server) {
+    if (!s_part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    static const httpd_uri_t logs_uri = {
+        .uri = "/logs",
+        .method = HTTP_GET,
+        .handler = logs_get_handler,
+        .user_ctx = NULL,
+    };
+
+    // Streaming the partition blocks on flash reads; run it on a worker
+    esp_err_t err = http_server_register_async_uri(server, &logs_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_STORE, "Failed to register /logs handler (%s)",
+                 esp_err_to_name(err));
+    }
+    return err;
+}
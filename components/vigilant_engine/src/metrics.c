@@ -0,0 +1,168 @@
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "http_server.h"
+#include "sdkconfig.h"
+#include "telemetry.h"
+#include "websocket.h"
+
+#if CONFIG_VE_ENABLE_I2C
+#include "i2c.h"
+#endif
+
+static const char* TAG_METRICS = "metrics";
+
+// Tasks whose stack high-water mark is exported, if they exist
+static const char* const s_stack_tasks[] = {
+    "main",        "httpd",       "ve_log_drain", "ve_log_store",
+    "sys_evt",     "esp_timer",   "tiT",          "status_led_blink",
+    "ve_httpd_w0", "ve_httpd_w1", "ve_i2c_bus",   "ve_sensors",
+    "ve_i2c_scan",
+};
+
+uint32_t metrics_counter_read(const metrics_counter_t* c) {
+    uint32_t sum = 0;
+    for (int i = 0; i < portNUM_PROCESSORS; ++i) {
+        sum += __atomic_load_n(&c->per_core[i], __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+static void out_flush(metrics_out_t* out) {
+    if (out->err == ESP_OK && out->len > 0) {
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+    }
+    out->len = 0;
+}
+
+static void out_printf(metrics_out_t* out, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void out_printf(metrics_out_t* out, const char* fmt, ...) {
+    if (out->err != ESP_OK) return;
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        size_t room = sizeof(out->buf) - out->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(out->buf + out->len, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < room) {
+            out->len += (size_t)n;
+            return;
+        }
+        out_flush(out);  // retry into the empty buffer
+    }
+    // A single line longer than the buffer; nothing we emit gets here
+    ESP_LOGW(TAG_METRICS, "metrics line too long, dropped");
+}
+
+void metrics_family(metrics_out_t* out, const char* name, const char* type,
+                    const char* help) {
+    out_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_sample(metrics_out_t* out, const char* name, const char* labels,
+                    uint64_t value) {
+    if (labels && labels[0]) {
+        out_printf(out, "%s{%s} %" PRIu64 "\n", name, labels, value);
+    } else {
+        out_printf(out, "%s %" PRIu64 "\n", name, value);
+    }
+}
+
+size_t metrics_escape_label(char* buf, size_t size, const char* value) {
+    size_t len = 0;
+    for (const char* c = value; *c; ++c) {
+        char esc[2] = {*c, 0};
+        if (*c == '\\' || *c == '"' || *c == '\n') {
+            esc[0] = '\\';
+            esc[1] = *c == '\n' ? 'n' : *c;
+        }
+        for (size_t i = 0; i < 2 && esc[i]; ++i, ++len) {
+            if (len + 1 < size) buf[len] = esc[i];
+        }
+    }
+    if (size > 0) buf[len < size ? len : size - 1] = '\0';
+    return len;
+}
+
+static void write_system_metrics(metrics_out_t* out) {
+    metrics_family(out, "ve_heap_free_bytes", "gauge",
+                   "Free heap (8-bit capable)");
+    metrics_sample(out, "ve_heap_free_bytes", NULL,
+                   heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    metrics_family(out, "ve_heap_min_free_bytes", "gauge",
+                   "Lowest free heap since boot");
+    metrics_sample(out, "ve_heap_min_free_bytes", NULL,
+                   heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    metrics_family(out, "ve_heap_largest_block_bytes", "gauge",
+                   "Largest free heap block");
+    metrics_sample(out, "ve_heap_largest_block_bytes", NULL,
+                   heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    metrics_family(out, "ve_task_stack_free_min_bytes", "gauge",
+                   "Stack high-water mark per task");
+    for (size_t i = 0; i < sizeof(s_stack_tasks) / sizeof(s_stack_tasks[0]);
+         ++i) {
+        TaskHandle_t task = xTaskGetHandle(s_stack_tasks[i]);
+        if (!task) {
+            continue;
+        }
+        char labels[40];
+        snprintf(labels, sizeof(labels), "task=\"%s\"", s_stack_tasks[i]);
+        metrics_sample(out, "ve_task_stack_free_min_bytes", labels,
+                       uxTaskGetStackHighWaterMark(task));
+    }
+
+    metrics_family(out, "ve_uptime_seconds", "gauge", "Time since boot");
+    metrics_sample(out, "ve_uptime_seconds", NULL,
+                   (uint64_t)(esp_timer_get_time() / 1000000));
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t* req) {
+    metrics_out_t scrape = {.req = req, .len = 0, .err = ESP_OK};
+    metrics_out_t* out = &scrape;
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    write_system_metrics(out);
+    http_server_write_metrics(out);
+    websocket_write_metrics(out);
+    telemetry_write_metrics(out);
+#if CONFIG_VE_ENABLE_I2C
+    i2c_write_metrics(out);
+#endif
+
+    out_flush(out);
+    if (out->err != ESP_OK) {
+        return out->err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t metrics_register_handlers(httpd_handle_t server) {
+    static const httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_get_handler,
+        .user_ctx = NULL,
+    };
+
+    esp_err_t err = http_server_register_uri(server, &metrics_uri);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG_METRICS, "Registered metrics GET handler at /metrics");
+    } else {
+        ESP_LOGE(TAG_METRICS, "Failed to register /metrics handler (%s)",
+                 esp_err_to_name(err));
+    }
+    return err;
+}
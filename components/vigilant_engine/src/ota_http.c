@@ -6,16 +6,20 @@
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
+#include "http_cache.h"
+#include "http_server.h"
 #include "soc/soc_caps.h"
 #include "status_led.h"
 
 static const char* TAG_OTA = "ota_http";
 
-// compiler embedded file symbols
-extern const unsigned char update_html_start[] asm(
-    "_binary_vigilant_html_start");  // HTML Vigilant File Start
-extern const unsigned char update_html_end[] asm(
-    "_binary_vigilant_html_end");  // HTML Vigilant File End
+// compiler embedded file symbols, see tools/compress_html.py
+extern const unsigned char vigilant_html_gz_start[] asm(
+    "_binary_vigilant_html_gz_start");  // gzip Vigilant HTML Start
+extern const unsigned char vigilant_html_gz_end[] asm(
+    "_binary_vigilant_html_gz_end");  // gzip Vigilant HTML End
+extern const char vigilant_html_etag[] asm(
+    "_binary_vigilant_html_etag_start");  // quoted ETag, null-terminated
 
 #define OTA_RECV_BUF_SIZE 1024
 
@@ -45,10 +49,9 @@ static esp_err_t reboot_factory_handler(httpd_req_t* req) {
 }
 
 static esp_err_t dashboard_get_handler(httpd_req_t* req) {
-    size_t html_size = update_html_end - update_html_start;
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char*)update_html_start, html_size);
-    return ESP_OK;
+    return http_cache_send_gzip(req, "text/html", vigilant_html_gz_start,
+                                vigilant_html_gz_end - vigilant_html_gz_start,
+                                vigilant_html_etag);
 }
 
 esp_err_t ota_http_register_handlers(httpd_handle_t server) {
@@ -69,7 +72,7 @@ esp_err_t ota_http_register_handlers(httpd_handle_t server) {
 
     esp_err_t err;
 
-    err = httpd_register_uri_handler(server, &ota_reboot_factory_get_uri);
+    err = http_server_register_uri(server, &ota_reboot_factory_get_uri);
     if (err == ESP_OK) {
         ESP_LOGI(
             TAG_OTA,
@@ -81,7 +84,7 @@ esp_err_t ota_http_register_handlers(httpd_handle_t server) {
         return err;
     }
 
-    err = httpd_register_uri_handler(server, &vigilant_get_uri);
+    err = http_server_register_uri(server, &vigilant_get_uri);
     if (err == ESP_OK) {
         ESP_LOGI(TAG_OTA,
                  "Registered Vigilant Dashboard HTTP GET handler at /");
@@ -0,0 +1,388 @@
+#include "sensors.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_server.h"
+#include "i2c.h"
+#include "json_writer.h"
+#include "sdkconfig.h"
+
+static const char* TAG_SENSORS = "ve_sensors";
+
+#define SENSOR_NAME_MAX 24
+#define SENSOR_TASK_STACK 3072
+// A reader only retries when a poll published during its copy; it gives up
+// after a few instead of spinning.
+#define SENSOR_READ_RETRIES 4
+
+// Double-buffered snapshot: the poll task writes the slot readers are not
+// pointed at and then bumps `seq`, which selects the other slot. A reader
+// copies slot `seq & 1` and retries if `seq` moved meanwhile, because the
+// next read after that reuses its slot.
+typedef struct {
+    uint8_t data[VIGILANT_SENSOR_MAX_LEN];
+    int64_t timestamp_us;
+} sensor_slot_t;
+
+typedef struct {
+    char name[SENSOR_NAME_MAX];
+    VigilantI2CDevice* device;
+    uint8_t reg;
+    uint8_t len;
+    uint32_t rate_hz;
+    int64_t period_us;
+    int64_t next_due_us;  // poll task only
+    sensor_slot_t slots[2];
+    _Atomic uint32_t seq;
+    metrics_counter_t reads;
+    metrics_counter_t errors;
+    metrics_counter_t overruns;  // polls skipped because the bus was late
+} sensor_t;
+
+// Append-only; an entry is filled in before it is counted.
+static sensor_t s_sensors[CONFIG_VE_SENSOR_MAX];
+static _Atomic uint32_t s_sensor_count = 0;
+
+static SemaphoreHandle_t s_add_mutex = NULL;
+static esp_timer_handle_t s_timer = NULL;
+// Guards s_task against the timer callback, which must not notify a task
+// that sensors_stop() is ending
+static SemaphoreHandle_t s_task_mutex = NULL;
+static TaskHandle_t s_task = NULL;
+static bool s_stopping = false;  // set by sensors_stop(), cleared on exit
+
+static void sensor_publish(sensor_t* s, const uint8_t* data, int64_t ts) {
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    sensor_slot_t* slot = &s->slots[(seq + 1) & 1];
+    memcpy(slot->data, data, s->len);
+    slot->timestamp_us = ts;
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_release);
+}
+
+static void sensor_poll(sensor_t* s, int64_t now) {
+    uint8_t data[VIGILANT_SENSOR_MAX_LEN];
+    esp_err_t err = i2c_read_regs(s->device, s->reg, data, s->len);
+    if (err == ESP_OK) {
+        sensor_publish(s, data, now);
+        metrics_counter_inc(&s->reads);
+    } else {
+        metrics_counter_inc(&s->errors);
+    }
+
+    // Keep the phase; if a whole period was lost, restart from now instead
+    // of bursting to catch up
+    s->next_due_us += s->period_us;
+    if (s->next_due_us <= now) {
+        metrics_counter_inc(&s->overruns);
+        s->next_due_us = now + s->period_us;
+    }
+}
+
+static void sensor_timer_cb(void* arg) {
+    (void)arg;
+    xSemaphoreTake(s_task_mutex, portMAX_DELAY);
+    if (s_task) xTaskNotifyGive(s_task);
+    xSemaphoreGive(s_task_mutex);
+}
+
+static bool sensors_stopping(void) {
+    return __atomic_load_n(&s_stopping, __ATOMIC_ACQUIRE);
+}
+
+// Rate-monotonic: of the sensors that are due, the one with the shortest
+// period is read first, and the choice is made again after every read, so a
+// 500 Hz IMU waits for at most one slower read.
+static void sensor_task(void* arg) {
+    (void)arg;
+    while (!sensors_stopping()) {
+        uint32_t count =
+            atomic_load_explicit(&s_sensor_count, memory_order_acquire);
+        int64_t now = esp_timer_get_time();
+        sensor_t* due = NULL;
+        int64_t next = INT64_MAX;
+        for (uint32_t i = 0; i < count; ++i) {
+            sensor_t* s = &s_sensors[i];
+            if (s->next_due_us <= now) {
+                if (!due || s->period_us < due->period_us) due = s;
+            } else if (s->next_due_us < next) {
+                next = s->next_due_us;
+            }
+        }
+        if (due) {
+            sensor_poll(due, now);
+            continue;
+        }
+
+        // Sleep until the next one is due or a sensor is added
+        if (next != INT64_MAX) {
+            esp_timer_stop(s_timer);
+            esp_timer_start_once(s_timer, (uint64_t)(next - now));
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    __atomic_store_n(&s_stopping, false, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+
+// Called with s_add_mutex held
+static esp_err_t sensors_start_task(void) {
+    if (s_task) return ESP_OK;
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreate(sensor_task, "ve_sensors", SENSOR_TASK_STACK, NULL,
+                    CONFIG_VE_SENSOR_TASK_PRIORITY, &task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(s_task_mutex, portMAX_DELAY);
+    s_task = task;
+    xSemaphoreGive(s_task_mutex);
+    return ESP_OK;
+}
+
+esp_err_t sensors_init(void) {
+    if (!s_task_mutex) {
+        s_task_mutex = xSemaphoreCreateMutex();
+        if (!s_task_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!s_add_mutex) {
+        s_add_mutex = xSemaphoreCreateMutex();
+        if (!s_add_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_add_mutex, portMAX_DELAY);
+    if (!s_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = sensor_timer_cb,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "ve_sensors",
+        };
+        err = esp_timer_create(&args, &s_timer);
+    }
+    // Resume sensors added before sensors_stop(), without a burst of
+    // overruns for the time the bus was down
+    uint32_t count = atomic_load(&s_sensor_count);
+    if (err == ESP_OK && count > 0 && !s_task) {
+        int64_t now = esp_timer_get_time();
+        for (uint32_t i = 0; i < count; ++i) {
+            s_sensors[i].next_due_us = now;
+        }
+        err = sensors_start_task();
+    }
+    xSemaphoreGive(s_add_mutex);
+    return err;
+}
+
+void sensors_stop(void) {
+    if (!s_add_mutex) return;
+
+    xSemaphoreTake(s_add_mutex, portMAX_DELAY);
+    xSemaphoreTake(s_task_mutex, portMAX_DELAY);
+    TaskHandle_t task = s_task;
+    s_task = NULL;
+    xSemaphoreGive(s_task_mutex);
+
+    if (task) {
+        __atomic_store_n(&s_stopping, true, __ATOMIC_RELEASE);
+        xTaskNotifyGive(task);
+        while (sensors_stopping()) {
+            vTaskDelay(1);
+        }
+    }
+    // The task may have armed it just before it exited. Without it
+    // sensors_add() fails until sensors_init() runs again.
+    if (s_timer) {
+        esp_timer_stop(s_timer);
+        esp_timer_delete(s_timer);
+        s_timer = NULL;
+    }
+    xSemaphoreGive(s_add_mutex);
+}
+
+esp_err_t sensors_add(const VigilantSensorConfig* config, int* id) {
+    if (!config || !config->device || !config->device->handle ||
+        config->len == 0 || config->len > VIGILANT_SENSOR_MAX_LEN ||
+        config->rate_hz == 0 || config->rate_hz > 1000000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_add_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_add_mutex, portMAX_DELAY);
+    esp_err_t err = s_timer ? sensors_start_task() : ESP_ERR_INVALID_STATE;
+    uint32_t count = atomic_load(&s_sensor_count);
+    if (err == ESP_OK && count >= CONFIG_VE_SENSOR_MAX) {
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err == ESP_OK) {
+        sensor_t* s = &s_sensors[count];
+        snprintf(s->name, sizeof(s->name), "%s",
+                 config->name ? config->name : "");
+        // Used as a /metrics label value, which cannot hold a raw quote,
+        // backslash or line break
+        for (char* c = s->name; *c; ++c) {
+            unsigned char ch = (unsigned char)*c;
+            if (ch == '"' || ch == '\\' || ch < 0x20 || ch == 0x7F) *c = '_';
+        }
+        s->device = config->device;
+        s->reg = config->reg;
+        s->len = config->len;
+        s->rate_hz = config->rate_hz;
+        s->period_us = 1000000 / config->rate_hz;
+        s->next_due_us = esp_timer_get_time();
+        atomic_init(&s->seq, 0);
+        atomic_store_explicit(&s_sensor_count, count + 1,
+                              memory_order_release);
+        if (id) *id = (int)count;
+        xTaskNotifyGive(s_task);
+    }
+    xSemaphoreGive(s_add_mutex);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_SENSORS, "Failed to add sensor %s: %s",
+                 config->name ? config->name : "", esp_err_to_name(err));
+    }
+    return err;
+}
+
+bool sensors_use_device(const VigilantI2CDevice* device) {
+    uint32_t count =
+        atomic_load_explicit(&s_sensor_count, memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (s_sensors[i].device == device) return true;
+    }
+    return false;
+}
+
+esp_err_t sensors_latest(int id, VigilantSensorSample* out) {
+    if (!out) return ESP_ERR_INVALID_ARG;
+    uint32_t count =
+        atomic_load_explicit(&s_sensor_count, memory_order_acquire);
+    if (id < 0 || (uint32_t)id >= count) return ESP_ERR_NOT_FOUND;
+
+    const sensor_t* s = &s_sensors[id];
+    for (int attempt = 0; attempt < SENSOR_READ_RETRIES; ++attempt) {
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (seq == 0) return ESP_ERR_INVALID_STATE;
+
+        const sensor_slot_t* slot = &s->slots[seq & 1];
+        memcpy(out->data, slot->data, s->len);
+        out->timestamp_us = slot->timestamp_us;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == seq) {
+            out->len = s->len;
+            out->seq = seq;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t sensors_get_handler(httpd_req_t* req) {
+    httpd_resp_set_type(req, "application/json");
+    char buf[JSON_WRITER_HTTP_BUF];
+    json_writer_t w;
+    json_writer_init_httpd(&w, req, buf, sizeof(buf));
+
+    int64_t now = esp_timer_get_time();
+    uint32_t count =
+        atomic_load_explicit(&s_sensor_count, memory_order_acquire);
+    json_writer_object_begin(&w);
+    json_writer_kv_int(&w, "now_us", now);
+    json_writer_key(&w, "sensors");
+    json_writer_array_begin(&w);
+    for (uint32_t i = 0; i < count; ++i) {
+        const sensor_t* s = &s_sensors[i];
+        VigilantSensorSample sample;
+        esp_err_t err = sensors_latest((int)i, &sample);
+
+        json_writer_object_begin(&w);
+        json_writer_kv_uint(&w, "id", i);
+        json_writer_kv_string(&w, "name", s->name);
+        json_writer_kv_uint(&w, "address", s->device->address);
+        json_writer_kv_uint(&w, "reg", s->reg);
+        json_writer_kv_uint(&w, "rate_hz", s->rate_hz);
+        json_writer_kv_uint(&w, "errors", metrics_counter_read(&s->errors));
+        if (err == ESP_OK) {
+            json_writer_kv_uint(&w, "seq", sample.seq);
+            json_writer_kv_int(&w, "timestamp_us", sample.timestamp_us);
+            json_writer_kv_int(&w, "age_us", now - sample.timestamp_us);
+            json_writer_key(&w, "data");
+            json_writer_array_begin(&w);
+            for (uint8_t b = 0; b < sample.len; ++b) {
+                json_writer_uint(&w, sample.data[b]);
+            }
+            json_writer_array_end(&w);
+        } else {
+            json_writer_key(&w, "data");
+            json_writer_null(&w);
+        }
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    return json_writer_finish(&w);
+}
+
+esp_err_t sensors_register_handlers(httpd_handle_t server) {
+    static const httpd_uri_t sensors_uri = {
+        .uri = "/sensors",
+        .method = HTTP_GET,
+        .handler = sensors_get_handler,
+        .user_ctx = NULL,
+    };
+
+    // Only copies snapshots, so it can stay on the httpd task
+    esp_err_t err = http_server_register_uri(server, &sensors_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_SENSORS, "Failed to register /sensors handler (%s)",
+                 esp_err_to_name(err));
+    }
+    return err;
+}
+
+void sensors_write_metrics(metrics_out_t* out) {
+    static const struct {
+        const char* name;
+        const char* help;
+        size_t offset;
+    } families[] = {
+        {"ve_sensor_reads_total", "Successful polls per sensor",
+         offsetof(sensor_t, reads)},
+        {"ve_sensor_errors_total", "Failed polls per sensor",
+         offsetof(sensor_t, errors)},
+        {"ve_sensor_overruns_total",
+         "Polls skipped because the sensor fell a period behind",
+         offsetof(sensor_t, overruns)},
+    };
+
+    uint32_t count =
+        atomic_load_explicit(&s_sensor_count, memory_order_acquire);
+    for (size_t f = 0; f < sizeof(families) / sizeof(families[0]); ++f) {
+        metrics_family(out, families[f].name, "counter", families[f].help);
+        for (uint32_t i = 0; i < count; ++i) {
+            char labels[48];
+            snprintf(labels, sizeof(labels), "sensor=\"%s\"",
+                     s_sensors[i].name);
+            const metrics_counter_t* counter =
+                (const metrics_counter_t*)((const char*)&s_sensors[i] +
+                                           families[f].offset);
+            metrics_sample(out, families[f].name, labels,
+                           metrics_counter_read(counter));
+        }
+    }
+}
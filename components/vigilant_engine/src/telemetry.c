@@ -0,0 +1,176 @@
+#include "telemetry.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "websocket.h"
+
+static const char* TAG_TELEMETRY = "telemetry";
+
+typedef struct {
+    uint16_t id;
+    char name[TELEMETRY_TOPIC_NAME_MAX];
+    _Atomic uint32_t seq;
+} telemetry_topic_t;
+
+static QueueHandle_t s_queue = NULL;
+static SemaphoreHandle_t s_topics_mutex = NULL;  // serializes adding topics
+
+// Entries are only appended; an entry is filled in before it is counted, so
+// publishers look topics up without taking the mutex.
+static telemetry_topic_t s_topics[CONFIG_VE_TELEMETRY_MAX_TOPICS];
+static _Atomic uint32_t s_topic_count = 0;
+
+static _Atomic uint32_t s_listeners = 0;
+static metrics_counter_t s_dropped;  // queue full
+
+esp_err_t telemetry_init(void) {
+    if (s_queue) return ESP_OK;
+
+    s_topics_mutex = xSemaphoreCreateMutex();
+    s_queue = xQueueCreate(CONFIG_VE_TELEMETRY_QUEUE_LEN,
+                           sizeof(telemetry_record_t));
+    if (!s_topics_mutex || !s_queue) {
+        ESP_LOGE(TAG_TELEMETRY, "queue create failed, telemetry off");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static telemetry_topic_t* find_topic(uint16_t topic) {
+    uint32_t count = atomic_load_explicit(&s_topic_count, memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (s_topics[i].id == topic) {
+            return &s_topics[i];
+        }
+    }
+    return NULL;
+}
+
+// Looks the topic up and adds it if it is new. `name` may be NULL.
+static esp_err_t get_topic(uint16_t topic, const char* name,
+                           telemetry_topic_t** out) {
+    *out = find_topic(topic);
+    if (*out && !name) return ESP_OK;
+    if (!s_topics_mutex) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_topics_mutex, portMAX_DELAY);
+    *out = find_topic(topic);
+    if (!*out) {
+        uint32_t count = atomic_load(&s_topic_count);
+        if (count < CONFIG_VE_TELEMETRY_MAX_TOPICS) {
+            telemetry_topic_t* t = &s_topics[count];
+            t->id = topic;
+            t->name[0] = '\0';
+            atomic_init(&t->seq, 0);
+            atomic_store_explicit(&s_topic_count, count + 1,
+                                  memory_order_release);
+            *out = t;
+        } else {
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+    if (*out && name) {
+        // Readers may see a partly written name; it is only for display
+        snprintf((*out)->name, sizeof((*out)->name), "%s", name);
+    }
+    xSemaphoreGive(s_topics_mutex);
+
+    if (err == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG_TELEMETRY,
+                 "No room for topic %u, raise VE_TELEMETRY_MAX_TOPICS",
+                 (unsigned)topic);
+    }
+    return err;
+}
+
+esp_err_t telemetry_register_topic(uint16_t topic, const char* name) {
+    if (!name) return ESP_ERR_INVALID_ARG;
+    telemetry_topic_t* t;
+    return get_topic(topic, name, &t);
+}
+
+esp_err_t telemetry_publish(uint16_t topic, const void* data, size_t len) {
+    if (!data && len > 0) return ESP_ERR_INVALID_ARG;
+    if (len > CONFIG_VE_TELEMETRY_MAX_PAYLOAD) return ESP_ERR_INVALID_SIZE;
+
+    telemetry_topic_t* t;
+    esp_err_t err = get_topic(topic, NULL, &t);
+    if (err != ESP_OK) return err;
+    uint32_t seq = atomic_fetch_add_explicit(&t->seq, 1, memory_order_relaxed);
+
+    // Nobody would see it; skip the copy and the wakeup
+    if (atomic_load_explicit(&s_listeners, memory_order_relaxed) == 0) {
+        return ESP_OK;
+    }
+
+    telemetry_record_t rec;
+    rec.topic = topic;
+    rec.len = (uint16_t)len;
+    rec.seq = seq;
+    rec.timestamp_us = esp_timer_get_time();
+    if (len > 0) {
+        memcpy(rec.data, data, len);
+    }
+    if (xQueueSend(s_queue, &rec, 0) != pdTRUE) {
+        metrics_counter_inc(&s_dropped);
+        return ESP_ERR_NO_MEM;
+    }
+    websocket_telemetry_pending();
+    return ESP_OK;
+}
+
+bool telemetry_receive(telemetry_record_t* out) {
+    return s_queue && xQueueReceive(s_queue, out, 0) == pdTRUE;
+}
+
+void telemetry_set_listeners(uint32_t count) {
+    atomic_store_explicit(&s_listeners, count, memory_order_relaxed);
+    if (count == 0 && s_queue) {
+        xQueueReset(s_queue);  // samples nobody is waiting for any more
+    }
+}
+
+void telemetry_write_topics(json_writer_t* w) {
+    uint32_t count = atomic_load_explicit(&s_topic_count, memory_order_acquire);
+    json_writer_array_begin(w);
+    for (uint32_t i = 0; i < count; ++i) {
+        const telemetry_topic_t* t = &s_topics[i];
+        json_writer_object_begin(w);
+        json_writer_kv_uint(w, "id", t->id);
+        json_writer_kv_string(w, "name", t->name);
+        json_writer_kv_uint(w, "seq", atomic_load(&t->seq));
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+}
+
+void telemetry_write_metrics(metrics_out_t* out) {
+    uint32_t count = atomic_load_explicit(&s_topic_count, memory_order_acquire);
+    metrics_family(out, "ve_telemetry_published_total", "counter",
+                   "Telemetry samples published per topic");
+    for (uint32_t i = 0; i < count; ++i) {
+        char labels[24];
+        snprintf(labels, sizeof(labels), "topic=\"%u\"",
+                 (unsigned)s_topics[i].id);
+        metrics_sample(out, "ve_telemetry_published_total", labels,
+                       atomic_load(&s_topics[i].seq));
+    }
+
+    metrics_family(out, "ve_telemetry_queued", "gauge",
+                   "Telemetry samples waiting for the drain task");
+    metrics_sample(out, "ve_telemetry_queued", NULL,
+                   s_queue ? uxQueueMessagesWaiting(s_queue) : 0);
+    metrics_family(out, "ve_telemetry_dropped_total", "counter",
+                   "Telemetry samples dropped because the queue was full");
+    metrics_sample(out, "ve_telemetry_dropped_total", NULL,
+                   metrics_counter_read(&s_dropped));
+}
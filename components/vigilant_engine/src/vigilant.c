@@ -14,11 +14,16 @@
 #include "freertos/timers.h"
 #include "http_server.h"
 #include "i2c.h"
+#include "i2c_async.h"
+#include "info_snapshot.h"
+#include "log_store.h"
 #include "lwip/inet.h"
 #include "nvs_flash.h"
 #include "sdkconfig.h"
+#include "sensors.h"
 #include "soc/soc_caps.h"
 #include "status_led.h"
+#include "telemetry.h"
 #include "websocket.h"
 
 #if defined(SOC_WIFI_SUPPORTED) && SOC_WIFI_SUPPORTED
@@ -72,6 +77,16 @@ static void wifi_evt(void* arg, esp_event_base_t base, int32_t id, void* data) {
         ip_event_got_ip_t* e = (ip_event_got_ip_t*)data;
         ESP_LOGI("wifi", "Got IP: " IPSTR, IP2STR(&e->ip_info.ip));
     }
+
+    // Everything /info reports that can change at runtime changes here
+    if ((base == WIFI_EVENT && (id == WIFI_EVENT_STA_CONNECTED ||
+                                id == WIFI_EVENT_STA_DISCONNECTED ||
+                                id == WIFI_EVENT_AP_START ||
+                                id == WIFI_EVENT_AP_STOP)) ||
+        (base == IP_EVENT &&
+         (id == IP_EVENT_STA_GOT_IP || id == IP_EVENT_STA_LOST_IP))) {
+        info_snapshot_refresh();
+    }
 }
 
 static esp_err_t wifi_init_once(void) {
@@ -89,6 +104,8 @@ static esp_err_t wifi_init_once(void) {
                                                &wifi_evt, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
                                                &wifi_evt, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_LOST_IP,
+                                               &wifi_evt, NULL));
 
     sta_reconnect_timer = xTimerCreate(
         "wifi_reconnect", pdMS_TO_TICKS(CONFIG_VE_STA_RECONNECT_INTERVAL_MS),
@@ -236,6 +253,18 @@ esp_err_t vigilant_init(VigilantConfig VgConfig) {
     // Capture ESP-IDF logs early so they can be replayed to websocket clients
     websocket_init_log_capture();
 
+    err = telemetry_init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry unavailable: %s", esp_err_to_name(err));
+    }
+
+#if CONFIG_VE_LOG_FLASH
+    err = log_store_init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Flash log unavailable: %s", esp_err_to_name(err));
+    }
+#endif
+
 #if defined(SOC_WIFI_SUPPORTED) && SOC_WIFI_SUPPORTED
     // Generate a unique SSID for the AP based on the device's MAC address
     uint8_t mac[6];
@@ -302,7 +331,8 @@ esp_err_t vigilant_init(VigilantConfig VgConfig) {
              VgConfig.unique_component_name);
     s_cfg = VgConfig;
 
-    // Set info status once
+    // Set info status once; network events keep it current from here on
+    info_snapshot_refresh();
 
     return ESP_OK;
 }
@@ -471,6 +501,112 @@ esp_err_t vigilant_i2c_write_regs(VigilantI2CDevice* device, uint8_t reg,
 #endif
 }
 
+esp_err_t vigilant_i2c_update_bits(VigilantI2CDevice* device, uint8_t reg,
+                                   uint8_t mask, uint8_t value) {
+#if CONFIG_VE_ENABLE_I2C
+    return i2c_update_bits(device, reg, mask, value);
+#else
+    (void)device;
+    (void)reg;
+    (void)mask;
+    (void)value;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t vigilant_i2c_set_bits(VigilantI2CDevice* device, uint8_t reg,
+                                uint8_t bits) {
+#if CONFIG_VE_ENABLE_I2C
+    return i2c_set_bits(device, reg, bits);
+#else
+    (void)device;
+    (void)reg;
+    (void)bits;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void vigilant_i2c_cache_invalidate(VigilantI2CDevice* device) {
+#if CONFIG_VE_ENABLE_I2C
+    i2c_cache_invalidate(device);
+#else
+    (void)device;
+#endif
+}
+
+esp_err_t vigilant_i2c_read_regs_async(VigilantI2CDevice* device, uint8_t reg,
+                                       uint8_t* data, size_t len,
+                                       const VigilantI2CAsync* done) {
+#if CONFIG_VE_ENABLE_I2C
+    return i2c_read_regs_async(device, reg, data, len, done);
+#else
+    (void)device;
+    (void)reg;
+    (void)data;
+    (void)len;
+    (void)done;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t vigilant_i2c_write_regs_async(VigilantI2CDevice* device,
+                                        uint8_t reg, const uint8_t* data,
+                                        size_t len,
+                                        const VigilantI2CAsync* done) {
+#if CONFIG_VE_ENABLE_I2C
+    return i2c_write_regs_async(device, reg, data, len, done);
+#else
+    (void)device;
+    (void)reg;
+    (void)data;
+    (void)len;
+    (void)done;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t vigilant_i2c_transaction(VigilantI2COp* ops, size_t count) {
+#if CONFIG_VE_ENABLE_I2C
+    return i2c_transaction(ops, count);
+#else
+    (void)ops;
+    (void)count;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t vigilant_i2c_transaction_async(VigilantI2COp* ops, size_t count,
+                                         const VigilantI2CAsync* done) {
+#if CONFIG_VE_ENABLE_I2C
+    return i2c_transaction_async(ops, count, done);
+#else
+    (void)ops;
+    (void)count;
+    (void)done;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t vigilant_sensor_add(const VigilantSensorConfig* config, int* id) {
+#if CONFIG_VE_ENABLE_I2C
+    return sensors_add(config, id);
+#else
+    (void)config;
+    (void)id;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t vigilant_sensor_latest(int id, VigilantSensorSample* sample) {
+#if CONFIG_VE_ENABLE_I2C
+    return sensors_latest(id, sample);
+#else
+    (void)id;
+    (void)sample;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 esp_err_t vigilant_i2c_whoami_check(VigilantI2CDevice* device) {
 #if CONFIG_VE_ENABLE_I2C
     return i2c_whoami_check(device);
@@ -479,3 +615,35 @@ esp_err_t vigilant_i2c_whoami_check(VigilantI2CDevice* device) {
     return ESP_ERR_NOT_SUPPORTED;
 #endif
 }
+
+static esp_err_t register_endpoint(const httpd_uri_t* endpoint, bool async) {
+    esp_err_t err = http_server_register_endpoint(endpoint, async);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register endpoint %s: %s",
+                 endpoint && endpoint->uri ? endpoint->uri : "(null)",
+                 esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t vigilant_register_endpoint(const httpd_uri_t* endpoint) {
+    return register_endpoint(endpoint, false);
+}
+
+esp_err_t vigilant_register_async_endpoint(const httpd_uri_t* endpoint) {
+    return register_endpoint(endpoint, true);
+}
+
+esp_err_t vigilant_endpoint_param(httpd_req_t* req, const char* name,
+                                  char* value, size_t size) {
+    return http_server_endpoint_param(req, name, value, size);
+}
+
+esp_err_t vigilant_telemetry_register_topic(uint16_t topic, const char* name) {
+    return telemetry_register_topic(topic, name);
+}
+
+esp_err_t vigilant_telemetry_publish(uint16_t topic, const void* data,
+                                     size_t len) {
+    return telemetry_publish(topic, data, len);
+}
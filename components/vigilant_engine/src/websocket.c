@@ -1,4 +1,6 @@
+#include <inttypes.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -9,46 +11,200 @@
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_server.h"
+#include "info_snapshot.h"
+#include "json_writer.h"
+#include "log_capture.h"
+#include "sdkconfig.h"
+#include "telemetry.h"
+#include "websocket.h"
 
 static const char* TAG_WS = "ws";
 
 #define MAX_WS_PAYLOAD (8 * 1024)
-#define LOG_HISTORY_LINES 200
-#define LOG_LINE_MAX 256
 #define MAX_WS_CLIENTS 8
-#define MAX_PENDING_SENDS_PER_CLIENT 3
-
+// Hard cap on queued work items per client; the byte budget
+// (CONFIG_VE_WS_CLIENT_BUDGET_KB) is the limit that normally applies.
+#define MAX_PENDING_SENDS_PER_CLIENT 4
+#define WS_CLIENT_BUDGET_BYTES (CONFIG_VE_WS_CLIENT_BUDGET_KB * 1024u)
+#define WS_COALESCE_LATENCY_US (CONFIG_VE_WS_COALESCE_LATENCY_MS * 1000u)
+#define WS_SLOW_CLIENT_TIMEOUT_US \
+    (CONFIG_VE_WS_SLOW_CLIENT_TIMEOUT_MS * 1000LL)
+// Broadcast payloads are shared by all clients and come from a small static
+// pool; only payloads larger than a pool buffer fall back to the heap.
+#define WS_PAYLOAD_POOL_COUNT 4
+#define WS_PAYLOAD_POOL_BUF (4 * 1024)
+// Room kept free in a batch buffer for the closing `],"next":N}`
+#define WS_BATCH_TAIL_RESERVE 32
+#define WS_SEND_ARG_POOL_COUNT (MAX_WS_CLIENTS * MAX_PENDING_SENDS_PER_CLIENT)
+#define WS_FILTER_MAX_TAGS 4
+#define WS_FILTER_MATCH_MAX 32
+// Comment line sent to idle /events clients, so dead peers are noticed and
+// proxies keep the stream open
+#define SSE_KEEPALIVE_MS 15000
+// EventSource reconnect delay sent with the stream headers
+#define SSE_RETRY "retry: 2000\n\n"
+#define WS_TELEMETRY_MAX_SUBS 8
+
+// Log subscription of one client, set with the "subscribe" command. The
+// all-zero filter passes every line.
+typedef struct {
+    uint8_t max_level;  // most verbose esp_log_level_t to pass, 0 for all
+    uint8_t include_count;
+    uint8_t exclude_count;
+    uint32_t include[WS_FILTER_MAX_TAGS];  // log_capture_tag_hash() values
+    uint32_t exclude[WS_FILTER_MAX_TAGS];
+    char match[WS_FILTER_MATCH_MAX];  // substring, empty for none
+} ws_log_filter_t;
+
+// Telemetry subscription of one client to one topic, set with the
+// "telemetry-subscribe" command.
+typedef struct {
+    uint16_t topic;
+    uint32_t interval_us;  // rate limit, 0 for every sample
+    int64_t next_due_us;   // sample timestamp the next one must reach
+} ws_telemetry_sub_t;
+
+// Backpressure: a client that is over its byte budget, or whose sends take
+// longer than CONFIG_VE_WS_COALESCE_LATENCY_MS, stops getting live batches.
+// Once its queue has drained it catches up from the capture ring with one
+// message. A client that even falls a full ring behind is downsampled to
+// warnings and errors; one that stays stuck is disconnected.
+typedef enum {
+    WS_FLOW_LIVE = 0,
+    WS_FLOW_COALESCE,
+} ws_flow_t;
+
+// Clients of /ws and of the /events SSE stream share the table and the send
+// path. An SSE client is a detached async request that stays open; its
+// messages go out as chunks of the never-ending response.
 typedef struct {
     int fd;
     bool active;
     uint32_t generation;
+    httpd_req_t* sse_req;  // detached GET /events request, NULL for /ws
     uint8_t pending_sends;
+    uint32_t queued_bytes;  // reserved by sends still queued on httpd
+    uint32_t latency_us;    // queue-to-written time per send, EWMA 1/8
+    ws_flow_t flow;
+    bool downsample;         // only W/E lines until the client keeps up
+    uint32_t catchup_seq;    // first line skipped while coalescing
+    int64_t coalesce_since;  // esp_timer time coalescing started
+    uint32_t sent_bytes;     // totals since the client connected
+    uint32_t dropped_bytes;
+    bool history_pending;  // history requested, not yet handed to httpd
+    uint32_t history_since;
+    ws_log_filter_t filter;
+    uint8_t telemetry_count;
+    ws_telemetry_sub_t telemetry[WS_TELEMETRY_MAX_SUBS];
 } ws_client_t;
 
+// Reference-counted frame payload. The last ws_send_text_async() completion
+// drops the final reference and returns the buffer to the pool (or frees it).
+typedef struct {
+    _Atomic uint32_t refs;
+    bool pooled;
+    char* data;
+    size_t len;
+    uint32_t event_id;  // SSE "id:" (the batch's "next"), 0 for none
+    bool binary;        // telemetry frame; never sent to SSE clients
+} ws_payload_t;
+
+// Clients with identical filters share one batch frame per flush. The batch
+// is written straight into its payload buffer.
+typedef struct {
+    ws_log_filter_t filter;
+    int fds[MAX_WS_CLIENTS];
+    size_t fd_count;
+    ws_payload_t* payload;  // NULL while no batch is open
+    json_writer_t w;
+    uint32_t batched;
+    uint32_t first_seq;  // sequence of the first line in the batch
+} ws_log_group_t;
+
 typedef struct {
+    atomic_bool in_use;
+    bool pooled;
     httpd_handle_t hd;
     int fd;
     uint32_t generation;
-    char* payload;
-    size_t len;
+    ws_payload_t* payload;
+    uint32_t since;  // history resume cursor, 0 for the full history
+    uint32_t upto;   // history end, the stream cursor when it was queued
+    uint32_t reserved;  // bytes counted against the client's budget
+    int64_t queued_at;
 } ws_send_arg_t;
 
+// History request picked up by the drain task.
+typedef struct {
+    int fd;
+    uint32_t since;
+} ws_history_req_t;
+
+// Telemetry frame being assembled for one subscribed client. The drain task
+// works on a copy of the subscriptions and writes the rate limit state back.
+typedef struct {
+    int fd;
+    uint32_t generation;
+    uint8_t sub_count;
+    ws_telemetry_sub_t subs[WS_TELEMETRY_MAX_SUBS];
+    ws_payload_t* payload;  // NULL while no frame is open
+    int64_t base_us;
+} ws_telemetry_out_t;
+
 static httpd_handle_t s_server_handle = NULL;
 static ws_client_t s_clients[MAX_WS_CLIENTS];
 
-static char s_log_lines[LOG_HISTORY_LINES][LOG_LINE_MAX];
-static size_t s_log_head = 0;   // next write position
-static size_t s_log_count = 0;  // number of valid lines
 static SemaphoreHandle_t s_ws_mutex = NULL;
 static uint32_t s_next_generation = 1;
 
+static ws_payload_t s_payload_pool[WS_PAYLOAD_POOL_COUNT];
+static char s_payload_storage[WS_PAYLOAD_POOL_COUNT][WS_PAYLOAD_POOL_BUF];
+static ws_send_arg_t s_send_arg_pool[WS_SEND_ARG_POOL_COUNT];
+
 static vprintf_like_t s_orig_vprintf = NULL;
 
+// Loggers only push into the lock-free capture ring and wake the drain task.
+// The drain task owns the stream cursor: it formats and serializes lines,
+// hands out history replays and queues the frames on the httpd task. Lines
+// are coalesced for up to CONFIG_VE_WS_LOG_BATCH_MS (or
+// CONFIG_VE_WS_LOG_BATCH_LINES lines) and sent as one frame per client.
+static TaskHandle_t s_drain_task = NULL;
+static _Atomic uint32_t s_batch_pending = 0;
+static uint32_t s_stream_seq = 1;  // next sequence to stream, drain task only
+#if CONFIG_VE_LOG_DEFERRED_CONSOLE
+static uint32_t s_console_seq = 1;  // next sequence to print, drain task only
+#endif
+static ws_log_group_t s_log_groups[MAX_WS_CLIENTS];  // drain task only
+static ws_history_req_t s_history_reqs[MAX_WS_CLIENTS];  // drain task only
+
+// Published samples wait in the telemetry queue; the first one wakes the
+// drain task, which sends them with the next log batch.
+static _Atomic uint32_t s_telemetry_pending = 0;
+static ws_telemetry_out_t s_telemetry_out[MAX_WS_CLIENTS];  // drain task only
+static telemetry_record_t s_telemetry_rec;                  // drain task only
+
+// Connected /events clients; the drain task only queues keepalives for them
+static _Atomic uint32_t s_sse_clients = 0;
+
+// Time spent in the capture hook, not counting the UART output
+static _Atomic uint32_t s_log_calls = 0;
+static _Atomic uint32_t s_log_time_us = 0;
+static _Atomic uint32_t s_log_time_max_us = 0;
+
+// Frame counters for /metrics
+static metrics_counter_t s_frames_sent;
+static metrics_counter_t s_frames_dropped;  // refused or failed sends
+static metrics_counter_t s_batches_skipped;  // left to a catch-up
+
 // Forward declarations
-static void send_log_history(int fd);
+static void send_log_history(int fd, uint32_t since);
 static esp_err_t ws_queue_send_text(int fd, const char* text);
+static void sse_finish_async(void* arg);
 
 static bool ws_client_is_connected(int fd) {
     if (!s_server_handle || fd < 0) {
@@ -72,98 +228,184 @@ static SemaphoreHandle_t ensure_mutex(void) {
                         // callers
 }
 
-static uint32_t ws_clients_add(int fd) {
+static void ws_client_reset(ws_client_t* c, int fd) {
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    c->active = true;
+    c->generation = next_generation();
+}
+
+// Recounts the /events clients. Call with the mutex held.
+static void ws_update_sse_clients(void) {
+    uint32_t count = 0;
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        count += s_clients[i].active && s_clients[i].sse_req;
+    }
+    atomic_store(&s_sse_clients, count);
+}
+
+static uint32_t ws_clients_add(int fd, httpd_req_t* sse_req) {
     ensure_mutex();
     if (!s_ws_mutex) return 0;
 
+    ws_client_t* slot = NULL;
     xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
-    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+    for (int i = 0; i < MAX_WS_CLIENTS && !slot; ++i) {
         if (s_clients[i].active && s_clients[i].fd == fd) {
-            s_clients[i].generation = next_generation();
-            s_clients[i].pending_sends = 0;
-            uint32_t generation = s_clients[i].generation;
-            xSemaphoreGive(s_ws_mutex);
-            return generation;
+            slot = &s_clients[i];
         }
     }
-
-    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+    for (int i = 0; i < MAX_WS_CLIENTS && !slot; ++i) {
         if (!s_clients[i].active) {
-            s_clients[i].fd = fd;
-            s_clients[i].active = true;
-            s_clients[i].generation = next_generation();
-            s_clients[i].pending_sends = 0;
-            uint32_t generation = s_clients[i].generation;
-            xSemaphoreGive(s_ws_mutex);
-            return generation;
+            slot = &s_clients[i];
         }
     }
+
+    uint32_t generation = 0;
+    if (slot) {
+        ws_client_reset(slot, fd);
+        slot->sse_req = sse_req;
+        generation = slot->generation;
+        ws_update_sse_clients();
+    }
     xSemaphoreGive(s_ws_mutex);
 
-    ESP_LOGW(TAG_WS, "WS client table full, dropping fd=%d", fd);
-    return 0;
+    if (!slot) {
+        ESP_LOGW(TAG_WS, "Client table full, dropping fd=%d", fd);
+    }
+    return generation;
+}
+
+// Tells the telemetry module whether anyone listens. Call with the mutex held.
+static void ws_update_telemetry_listeners(void) {
+    uint32_t listeners = 0;
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        listeners += s_clients[i].active && s_clients[i].telemetry_count > 0;
+    }
+    telemetry_set_listeners(listeners);
 }
 
-static bool ws_clients_remove_generation(int fd, uint32_t generation) {
+// Removes the client. For an SSE client, `sse_req` receives the detached
+// request, which the caller must complete on the httpd task.
+static bool ws_clients_remove_generation(int fd, uint32_t generation,
+                                         httpd_req_t** sse_req) {
+    if (sse_req) *sse_req = NULL;
     if (!s_ws_mutex) return false;
     bool removed = false;
     xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
     for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
         if (s_clients[i].active && s_clients[i].fd == fd &&
             (generation == 0 || s_clients[i].generation == generation)) {
+            if (sse_req) *sse_req = s_clients[i].sse_req;
             s_clients[i].active = false;
             s_clients[i].fd = -1;
             s_clients[i].generation = 0;
+            s_clients[i].sse_req = NULL;
             s_clients[i].pending_sends = 0;
+            s_clients[i].telemetry_count = 0;
             removed = true;
         }
     }
+    if (removed) {
+        ws_update_telemetry_listeners();
+        ws_update_sse_clients();
+    }
     xSemaphoreGive(s_ws_mutex);
     return removed;
 }
 
+// For /ws clients only
 static void ws_clients_remove(int fd) {
-    (void)ws_clients_remove_generation(fd, 0);
+    (void)ws_clients_remove_generation(fd, 0, NULL);
 }
 
-static bool ws_clients_mark_send_queued(int fd, uint32_t* generation) {
+// Reserves `bytes` of the client's budget for one send. For log batches
+// (`first_seq` != 0) a client that is over budget or slow switches to
+// coalescing instead of losing the lines; other messages are dropped.
+static bool ws_clients_reserve_send(int fd, uint32_t bytes, uint32_t first_seq,
+                                    uint32_t* generation) {
     SemaphoreHandle_t mutex = ensure_mutex();
     if (!mutex) return false;
-    if (!s_ws_mutex) return false;
 
     bool queued = false;
     xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
     for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
-        if (s_clients[i].active && s_clients[i].fd == fd) {
-            if (s_clients[i].pending_sends < MAX_PENDING_SENDS_PER_CLIENT) {
-                s_clients[i].pending_sends++;
-                *generation = s_clients[i].generation;
-                queued = true;
+        ws_client_t* c = &s_clients[i];
+        if (!c->active || c->fd != fd) {
+            continue;
+        }
+        if (first_seq != 0 && c->flow == WS_FLOW_COALESCE) {
+            metrics_counter_inc(&s_batches_skipped);
+            break;  // the catch-up covers this batch
+        }
+
+        // Histories reserve nothing and only stop at the hard cap
+        bool over = c->pending_sends >= MAX_PENDING_SENDS_PER_CLIENT ||
+                    (bytes > 0 && c->queued_bytes > 0 &&
+                     c->queued_bytes + bytes > WS_CLIENT_BUDGET_BYTES);
+        bool slow = first_seq != 0 && c->latency_us > WS_COALESCE_LATENCY_US;
+        if (over || slow) {
+            if (first_seq != 0) {
+                c->flow = WS_FLOW_COALESCE;
+                c->catchup_seq = first_seq;
+                c->coalesce_since = esp_timer_get_time();
+                metrics_counter_inc(&s_batches_skipped);
+            } else {
+                c->dropped_bytes += bytes;
+                metrics_counter_inc(&s_frames_dropped);
             }
             break;
         }
+
+        c->pending_sends++;
+        c->queued_bytes += bytes;
+        *generation = c->generation;
+        queued = true;
+        break;
     }
     xSemaphoreGive(s_ws_mutex);
     return queued;
 }
 
-static void ws_clients_mark_send_done(int fd, uint32_t generation) {
+// Releases a reservation. `queued_at` is 0 for sends that never reached the
+// socket, which are not counted as a latency sample.
+static void ws_clients_mark_send_done(int fd, uint32_t generation,
+                                      uint32_t reserved, uint32_t sent,
+                                      int64_t queued_at) {
     if (!s_ws_mutex) return;
 
     xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
     for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
-        if (s_clients[i].active && s_clients[i].fd == fd &&
-            s_clients[i].generation == generation) {
-            if (s_clients[i].pending_sends > 0) {
-                s_clients[i].pending_sends--;
-            }
-            break;
+        ws_client_t* c = &s_clients[i];
+        if (!c->active || c->fd != fd || c->generation != generation) {
+            continue;
         }
+        if (c->pending_sends > 0) {
+            c->pending_sends--;
+        }
+        c->queued_bytes -= reserved < c->queued_bytes ? reserved
+                                                      : c->queued_bytes;
+        c->sent_bytes += sent;
+        if (sent < reserved) {
+            c->dropped_bytes += reserved - sent;
+        }
+        if (queued_at > 0) {
+            int64_t sample = esp_timer_get_time() - queued_at;
+            uint32_t us = sample > UINT32_MAX ? UINT32_MAX : (uint32_t)sample;
+            c->latency_us = c->latency_us - c->latency_us / 8 + us / 8;
+        }
+        break;
     }
     xSemaphoreGive(s_ws_mutex);
 }
 
-static bool ws_client_generation_is_current(int fd, uint32_t generation) {
+// Checks that `generation` is still the client on `fd` and, if so, whether it
+// is still reachable. `sse_req` receives its /events request (NULL for /ws);
+// it stays valid for the current httpd work item, because SSE requests are
+// only completed on the httpd task.
+static bool ws_client_lookup(int fd, uint32_t generation,
+                             httpd_req_t** sse_req) {
+    *sse_req = NULL;
     if (!s_ws_mutex) return false;
 
     bool current = false;
@@ -171,17 +413,28 @@ static bool ws_client_generation_is_current(int fd, uint32_t generation) {
     for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
         if (s_clients[i].active && s_clients[i].fd == fd &&
             s_clients[i].generation == generation) {
+            *sse_req = s_clients[i].sse_req;
             current = true;
             break;
         }
     }
     xSemaphoreGive(s_ws_mutex);
-    return current;
+
+    // A broken SSE stream shows up as a failed send instead
+    return current && (*sse_req || ws_client_is_connected(fd));
 }
 
 static void ws_trigger_close_if_current(int fd, uint32_t generation) {
-    if (ws_clients_remove_generation(fd, generation) && s_server_handle) {
+    httpd_req_t* sse_req = NULL;
+    if (!ws_clients_remove_generation(fd, generation, &sse_req) ||
+        !s_server_handle) {
+        return;
+    }
+    if (!sse_req) {
         httpd_sess_trigger_close(s_server_handle, fd);
+    } else if (httpd_queue_work(s_server_handle, sse_finish_async, sse_req) !=
+               ESP_OK) {
+        ESP_LOGE(TAG_WS, "Could not queue close of SSE client fd=%d", fd);
     }
 }
 
@@ -191,137 +444,883 @@ static bool should_stream_log_line(const char* line) {
     return !strstr(line, " httpd_txrx:") && !strstr(line, " httpd_ws:");
 }
 
-static void append_log_line(const char* line) {
-    ensure_mutex();
-    if (!s_ws_mutex) return;
+// Claims a free pool buffer holding one reference, or NULL if all are in
+// flight.
+static ws_payload_t* ws_payload_from_pool(void) {
+    for (int i = 0; i < WS_PAYLOAD_POOL_COUNT; ++i) {
+        uint32_t expected = 0;
+        if (atomic_compare_exchange_strong(&s_payload_pool[i].refs, &expected,
+                                           1)) {
+            ws_payload_t* p = &s_payload_pool[i];
+            p->pooled = true;
+            p->data = s_payload_storage[i];
+            p->len = 0;
+            p->event_id = 0;
+            p->binary = false;
+            return p;
+        }
+    }
+    return NULL;
+}
 
-    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
-    strncpy(s_log_lines[s_log_head], line, LOG_LINE_MAX - 1);
-    s_log_lines[s_log_head][LOG_LINE_MAX - 1] = '\0';
+// Takes ownership of a heap string.
+static ws_payload_t* ws_payload_wrap_heap(char* data, size_t len) {
+    ws_payload_t* p = (ws_payload_t*)malloc(sizeof(ws_payload_t));
+    if (!p) {
+        free(data);
+        return NULL;
+    }
+    atomic_init(&p->refs, 1);
+    p->pooled = false;
+    p->data = data;
+    p->len = len;
+    p->event_id = 0;
+    p->binary = false;
+    return p;
+}
 
-    s_log_head = (s_log_head + 1) % LOG_HISTORY_LINES;
-    if (s_log_count < LOG_HISTORY_LINES) {
-        s_log_count++;
+static ws_payload_t* ws_payload_from_text(const char* text) {
+    size_t len = strlen(text);
+    ws_payload_t* p = len < WS_PAYLOAD_POOL_BUF ? ws_payload_from_pool() : NULL;
+    if (p) {
+        memcpy(p->data, text, len + 1);
+        p->len = len;
+        return p;
     }
-    xSemaphoreGive(s_ws_mutex);
+
+    char* dup = strdup(text);
+    return dup ? ws_payload_wrap_heap(dup, len) : NULL;
+}
+
+// Buffer of WS_PAYLOAD_POOL_BUF bytes for a message that is written in place;
+// from the pool if one is free.
+static ws_payload_t* ws_payload_alloc(void) {
+    ws_payload_t* p = ws_payload_from_pool();
+    if (p) {
+        return p;
+    }
+
+    char* data = (char*)malloc(WS_PAYLOAD_POOL_BUF);
+    return data ? ws_payload_wrap_heap(data, 0) : NULL;
+}
+
+static void ws_payload_retain(ws_payload_t* p) {
+    atomic_fetch_add_explicit(&p->refs, 1, memory_order_relaxed);
+}
+
+static void ws_payload_release(ws_payload_t* p) {
+    if (!p || atomic_fetch_sub_explicit(&p->refs, 1, memory_order_acq_rel) !=
+                  1) {
+        return;
+    }
+    // Pooled buffers are free again once refs reaches zero
+    if (!p->pooled) {
+        free(p->data);
+        free(p);
+    }
+}
+
+static ws_send_arg_t* ws_send_arg_alloc(void) {
+    for (int i = 0; i < WS_SEND_ARG_POOL_COUNT; ++i) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&s_send_arg_pool[i].in_use,
+                                           &expected, true)) {
+            s_send_arg_pool[i].pooled = true;
+            return &s_send_arg_pool[i];
+        }
+    }
+
+    // Only reachable if sends outlive their client entry
+    ws_send_arg_t* a = (ws_send_arg_t*)calloc(1, sizeof(ws_send_arg_t));
+    if (a) {
+        a->pooled = false;
+    }
+    return a;
+}
+
+static void ws_send_arg_free(ws_send_arg_t* a) {
+    ws_payload_release(a->payload);
+    a->payload = NULL;
+    if (a->pooled) {
+        atomic_store(&a->in_use, false);
+    } else {
+        free(a);
+    }
+}
+
+static esp_err_t sse_send_all(httpd_req_t* req, const char* data, size_t len) {
+    while (len > 0) {
+        int n = httpd_send(req, data, len);
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    const char* data;
+    size_t len;
+} sse_piece_t;
+
+// Writes the pieces as one HTTP chunk of the /events response, with three
+// socket writes per piece less than httpd_resp_send_chunk() would need.
+static esp_err_t sse_send_chunk(httpd_req_t* req, const sse_piece_t* pieces,
+                                size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += pieces[i].len;
+    }
+    if (total == 0) {
+        return ESP_OK;  // a zero-size chunk would end the response
+    }
+
+    char head[12];
+    int n = snprintf(head, sizeof(head), "%x\r\n", (unsigned)total);
+    esp_err_t err = sse_send_all(req, head, (size_t)n);
+    for (size_t i = 0; i < count && err == ESP_OK; ++i) {
+        err = sse_send_all(req, pieces[i].data, pieces[i].len);
+    }
+    if (err == ESP_OK) {
+        err = sse_send_all(req, "\r\n", 2);
+    }
+    return err;
+}
+
+// Writes one message as an SSE event. The JSON has no raw newlines, so it
+// fits on a single data line.
+static esp_err_t sse_send_event(httpd_req_t* req, const ws_payload_t* p) {
+    char fields[32];
+    int n = p->event_id != 0 ? snprintf(fields, sizeof(fields),
+                                        "id: %" PRIu32 "\ndata: ", p->event_id)
+                             : snprintf(fields, sizeof(fields), "data: ");
+    const sse_piece_t pieces[] = {
+        {fields, (size_t)n},
+        {p->data, p->len},
+        {"\n\n", 2},
+    };
+    return sse_send_chunk(req, pieces, sizeof(pieces) / sizeof(pieces[0]));
+}
+
+// Hands a closed /events request back to httpd and closes its socket. Runs on
+// the httpd task, after any send that may still use the request.
+static void sse_finish_async(void* arg) {
+    httpd_req_t* req = (httpd_req_t*)arg;
+    httpd_handle_t hd = req->handle;
+    int fd = httpd_req_to_sockfd(req);
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(hd, fd);
 }
 
 static void ws_send_text_async(void* arg) {
     ws_send_arg_t* a = (ws_send_arg_t*)arg;
     if (!a) return;
 
-    if (!ws_client_generation_is_current(a->fd, a->generation) ||
-        !ws_client_is_connected(a->fd)) {
-        ws_clients_mark_send_done(a->fd, a->generation);
+    httpd_req_t* sse_req = NULL;
+    if (!ws_client_lookup(a->fd, a->generation, &sse_req)) {
+        ws_clients_mark_send_done(a->fd, a->generation, a->reserved, 0, 0);
         ws_trigger_close_if_current(a->fd, a->generation);
-        free(a->payload);
-        free(a);
+        ws_send_arg_free(a);
         return;
     }
 
-    httpd_ws_frame_t frame = {
-        .final = true,
-        .fragmented = false,
-        .type = HTTPD_WS_TYPE_TEXT,
-        .payload = (uint8_t*)a->payload,
-        .len = a->len,
-    };
-
-    esp_err_t ret = httpd_ws_send_frame_async(a->hd, a->fd, &frame);
-    ws_clients_mark_send_done(a->fd, a->generation);
-    if (ret != ESP_OK) {
+    esp_err_t ret;
+    if (sse_req && a->payload->binary) {
+        ret = ESP_ERR_NOT_SUPPORTED;  // SSE clients cannot subscribe
+    } else if (sse_req) {
+        ret = sse_send_event(sse_req, a->payload);
+    } else {
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .fragmented = false,
+            .type = a->payload->binary ? HTTPD_WS_TYPE_BINARY
+                                       : HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t*)a->payload->data,
+            .len = a->payload->len,
+        };
+        ret = httpd_ws_send_frame_async(a->hd, a->fd, &frame);
+    }
+    metrics_counter_inc(ret == ESP_OK ? &s_frames_sent : &s_frames_dropped);
+    ws_clients_mark_send_done(a->fd, a->generation, a->reserved,
+                              ret == ESP_OK ? a->reserved : 0, a->queued_at);
+    // A client that took this long for one frame is not coming back
+    if (ret != ESP_OK ||
+        esp_timer_get_time() - a->queued_at > WS_SLOW_CLIENT_TIMEOUT_US) {
         ws_trigger_close_if_current(a->fd, a->generation);
     }
 
-    free(a->payload);
-    free(a);
+    ws_send_arg_free(a);
 }
 
-static esp_err_t ws_queue_send_text(int fd, const char* text) {
-    if (!s_server_handle || !text) {
+// Queues a send of `payload` to one client; the send holds its own reference.
+// `first_seq` is the first line of a log batch, 0 for other messages.
+static esp_err_t ws_queue_send_payload(int fd, ws_payload_t* payload,
+                                       uint32_t first_seq) {
+    if (!s_server_handle || !payload) {
         return ESP_ERR_INVALID_STATE;
     }
 
+    uint32_t bytes = (uint32_t)payload->len;
     uint32_t generation = 0;
-    if (!ws_clients_mark_send_queued(fd, &generation)) {
+    if (!ws_clients_reserve_send(fd, bytes, first_seq, &generation)) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    ws_send_arg_t* arg = (ws_send_arg_t*)malloc(sizeof(ws_send_arg_t));
-    char* dup = strdup(text);
-    if (!arg || !dup) {
-        free(arg);
-        free(dup);
-        ws_clients_mark_send_done(fd, generation);
+    ws_send_arg_t* arg = ws_send_arg_alloc();
+    if (!arg) {
+        ws_clients_mark_send_done(fd, generation, bytes, 0, 0);
         return ESP_ERR_NO_MEM;
     }
 
+    ws_payload_retain(payload);
     arg->hd = s_server_handle;
     arg->fd = fd;
     arg->generation = generation;
-    arg->payload = dup;
-    arg->len = strlen(dup);
+    arg->payload = payload;
+    arg->reserved = bytes;
+    arg->queued_at = esp_timer_get_time();
 
     esp_err_t ret = httpd_queue_work(s_server_handle, ws_send_text_async, arg);
     if (ret != ESP_OK) {
-        free(arg->payload);
-        free(arg);
-        ws_clients_mark_send_done(fd, generation);
+        ws_send_arg_free(arg);
+        ws_clients_mark_send_done(fd, generation, bytes, 0, 0);
     }
     return ret;
 }
 
-static void broadcast_log_line(const char* line) {
-    ensure_mutex();
+static esp_err_t ws_queue_send_text(int fd, const char* text) {
+    if (!s_server_handle || !text) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ws_payload_t* payload = ws_payload_from_text(text);
+    if (!payload) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ws_queue_send_payload(fd, payload, 0);
+    ws_payload_release(payload);
+    return ret;
+}
+
+static bool ws_log_filter_equal(const ws_log_filter_t* a,
+                                const ws_log_filter_t* b) {
+    return a->max_level == b->max_level &&
+           a->include_count == b->include_count &&
+           a->exclude_count == b->exclude_count &&
+           memcmp(a->include, b->include,
+                  a->include_count * sizeof(a->include[0])) == 0 &&
+           memcmp(a->exclude, b->exclude,
+                  a->exclude_count * sizeof(a->exclude[0])) == 0 &&
+           strcmp(a->match, b->match) == 0;
+}
+
+// Only compares the metadata recorded at capture time, plus an optional
+// substring search.
+static bool ws_log_filter_match(const ws_log_filter_t* f,
+                                const log_capture_meta_t* meta,
+                                const char* line) {
+    // Lines without a level (plain printf output) always pass the level check
+    if (f->max_level && meta->level > f->max_level) {
+        return false;
+    }
+    if (f->include_count) {
+        bool found = false;
+        for (uint8_t i = 0; i < f->include_count && !found; ++i) {
+            found = f->include[i] == meta->tag_hash;
+        }
+        if (!found) return false;
+    }
+    for (uint8_t i = 0; i < f->exclude_count; ++i) {
+        if (f->exclude[i] == meta->tag_hash) return false;
+    }
+    return !f->match[0] || strstr(line, f->match);
+}
+
+// Filter a client actually gets: a downsampled client only sees warnings and
+// errors on top of its own filter.
+static ws_log_filter_t ws_client_effective_filter(const ws_client_t* c) {
+    ws_log_filter_t f = c->filter;
+    if (c->downsample && (!f.max_level || f.max_level > ESP_LOG_WARN)) {
+        f.max_level = ESP_LOG_WARN;
+    }
+    return f;
+}
+
+// Collects the clients for the next batch, grouped by filter, and takes
+// their pending history requests. A coalescing client rejoins once its queue
+// has drained, with a history request that catches it up; one that stays
+// stuck is closed. Returns the number of groups.
+static size_t ws_clients_group_by_filter(ws_log_group_t* groups,
+                                         ws_history_req_t* reqs,
+                                         size_t* req_count, uint32_t oldest) {
+    *req_count = 0;
+    if (!s_ws_mutex) return 0;
+
+    int stuck_fds[MAX_WS_CLIENTS];
+    uint32_t stuck_gens[MAX_WS_CLIENTS];
+    size_t stuck_count = 0;
+    int64_t now = esp_timer_get_time();
+
+    size_t group_count = 0;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        ws_client_t* c = &s_clients[i];
+        if (!c->active) {
+            continue;
+        }
+
+        if (c->flow == WS_FLOW_COALESCE) {
+            if (c->pending_sends > 0) {
+                if (now - c->coalesce_since > WS_SLOW_CLIENT_TIMEOUT_US) {
+                    stuck_fds[stuck_count] = c->fd;
+                    stuck_gens[stuck_count] = c->generation;
+                    stuck_count++;
+                }
+                continue;  // keeps its history request for later
+            }
+            if ((int32_t)(c->catchup_seq - oldest) < 0) {
+                c->downsample = true;  // it missed a full ring
+            }
+            if (!c->history_pending) {
+                c->history_pending = true;
+                c->history_since = c->catchup_seq;
+            }
+            c->flow = WS_FLOW_LIVE;
+        } else if (c->downsample && c->queued_bytes == 0 &&
+                   c->latency_us < WS_COALESCE_LATENCY_US / 2) {
+            c->downsample = false;
+        }
+
+        if (c->history_pending) {
+            reqs[*req_count].fd = c->fd;
+            reqs[*req_count].since = c->history_since;
+            (*req_count)++;
+            c->history_pending = false;
+        }
+
+        ws_log_filter_t filter = ws_client_effective_filter(c);
+        ws_log_group_t* g = NULL;
+        for (size_t k = 0; k < group_count; ++k) {
+            if (ws_log_filter_equal(&groups[k].filter, &filter)) {
+                g = &groups[k];
+                break;
+            }
+        }
+        if (!g) {
+            g = &groups[group_count++];
+            g->filter = filter;
+            g->fd_count = 0;
+            g->payload = NULL;
+            g->batched = 0;
+            g->first_seq = 0;
+        }
+        g->fds[g->fd_count++] = c->fd;
+    }
+    xSemaphoreGive(s_ws_mutex);
+
+    for (size_t i = 0; i < stuck_count; ++i) {
+        ESP_LOGW(TAG_WS, "Closing stalled WS client fd=%d", stuck_fds[i]);
+        ws_trigger_close_if_current(stuck_fds[i], stuck_gens[i]);
+    }
+    return group_count;
+}
+
+static void ws_clients_set_filter(int fd, const ws_log_filter_t* filter) {
     if (!s_ws_mutex) return;
 
-    int fds[MAX_WS_CLIENTS];
-    size_t cnt = 0;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        if (s_clients[i].active && s_clients[i].fd == fd) {
+            s_clients[i].filter = *filter;
+            break;
+        }
+    }
+    xSemaphoreGive(s_ws_mutex);
+}
+
+// Replaces the client's telemetry subscriptions.
+static void ws_clients_set_telemetry(int fd, const ws_telemetry_sub_t* subs,
+                                     uint8_t count) {
+    if (!s_ws_mutex) return;
 
     xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
     for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
-        if (s_clients[i].active) {
-            fds[cnt++] = s_clients[i].fd;
+        if (s_clients[i].active && s_clients[i].fd == fd) {
+            memcpy(s_clients[i].telemetry, subs, count * sizeof(subs[0]));
+            s_clients[i].telemetry_count = count;
+            break;
+        }
+    }
+    ws_update_telemetry_listeners();
+    xSemaphoreGive(s_ws_mutex);
+}
+
+static void ws_clients_get_filter(int fd, ws_log_filter_t* filter) {
+    memset(filter, 0, sizeof(*filter));
+    if (!s_ws_mutex) return;
+
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        if (s_clients[i].active && s_clients[i].fd == fd) {
+            *filter = ws_client_effective_filter(&s_clients[i]);
+            break;
+        }
+    }
+    xSemaphoreGive(s_ws_mutex);
+}
+
+// Writes the "ws-stats" reply: flow state and byte counters of every client.
+// The writer may send frames as it goes, so the fields are copied first and
+// no socket write happens with s_ws_mutex held.
+static void ws_clients_write_stats(json_writer_t* w, int self_fd) {
+    struct {
+        int fd;
+        bool sse;
+        const char* mode;
+        uint32_t queued;
+        uint32_t sent;
+        uint32_t dropped;
+        uint32_t latency_us;
+    } stats[MAX_WS_CLIENTS];
+    int count = 0;
+    if (s_ws_mutex) {
+        xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+        for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+            const ws_client_t* c = &s_clients[i];
+            if (!c->active) {
+                continue;
+            }
+            stats[count].fd = c->fd;
+            stats[count].sse = c->sse_req != NULL;
+            stats[count].mode = c->flow == WS_FLOW_COALESCE ? "coalesce"
+                                : c->downsample             ? "downsample"
+                                                            : "live";
+            stats[count].queued = c->queued_bytes;
+            stats[count].sent = c->sent_bytes;
+            stats[count].dropped = c->dropped_bytes;
+            stats[count].latency_us = c->latency_us;
+            count++;
+        }
+        xSemaphoreGive(s_ws_mutex);
+    }
+
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "type", "ws-stats");
+    json_writer_kv_int(w, "self", self_fd);
+    json_writer_key(w, "clients");
+    json_writer_array_begin(w);
+    for (int i = 0; i < count; ++i) {
+        json_writer_object_begin(w);
+        json_writer_kv_int(w, "fd", stats[i].fd);
+        json_writer_kv_string(w, "transport", stats[i].sse ? "sse" : "ws");
+        json_writer_kv_string(w, "mode", stats[i].mode);
+        json_writer_kv_uint(w, "queued", stats[i].queued);
+        json_writer_kv_uint(w, "sent", stats[i].sent);
+        json_writer_kv_uint(w, "dropped", stats[i].dropped);
+        json_writer_kv_uint(w, "latency_ms", stats[i].latency_us / 1000);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+    json_writer_object_end(w);
+}
+
+// The drain task picks the request up with its next batch, so the history
+// and the live stream meet exactly at the stream cursor.
+static bool ws_clients_request_history(int fd, uint32_t since) {
+    if (!s_ws_mutex) return false;
+
+    bool found = false;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        if (s_clients[i].active && s_clients[i].fd == fd) {
+            s_clients[i].history_pending = true;
+            s_clients[i].history_since = since;
+            found = true;
+            break;
         }
     }
     xSemaphoreGive(s_ws_mutex);
+    return found;
+}
 
-    if (cnt == 0) {
+// Closes a group's batch and sends it to each of its clients. `next` is the
+// first sequence not in the batch. A client that is over its budget skips the
+// batch and is caught up later (see ws_flow_t).
+static void broadcast_log_batch(ws_log_group_t* g, uint32_t next) {
+    ws_payload_t* payload = g->payload;
+    json_writer_t* w = &g->w;
+    g->payload = NULL;
+    g->batched = 0;
+
+    // Clients resume from "next" after a reconnect
+    w->cap = WS_PAYLOAD_POOL_BUF;  // release the tail reserve
+    json_writer_array_end(w);
+    json_writer_kv_uint(w, "next", next);
+    json_writer_object_end(w);
+    if (json_writer_finish(w) != ESP_OK) {
+        ws_payload_release(payload);
         return;
     }
+    payload->len = w->len;
+    payload->event_id = next;
 
-    cJSON* root = cJSON_CreateObject();
-    if (!root) return;
-    cJSON_AddStringToObject(root, "type", "log");
-    cJSON_AddStringToObject(root, "line", line);
-    char* out = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!out) return;
+    // One shared payload for all clients of the group
+    for (size_t i = 0; i < g->fd_count; ++i) {
+        (void)ws_queue_send_payload(g->fds[i], payload, g->first_seq);
+    }
+    ws_payload_release(payload);
+}
+
+static bool log_batch_begin(ws_log_group_t* g, uint32_t first_seq) {
+    g->payload = ws_payload_alloc();
+    if (!g->payload) return false;
+
+    json_writer_t* w = &g->w;
+    json_writer_init(w, g->payload->data,
+                     WS_PAYLOAD_POOL_BUF - WS_BATCH_TAIL_RESERVE, NULL, NULL);
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "type", "logs");
+    json_writer_kv_bool(w, "append", true);
+    json_writer_key(w, "lines");
+    json_writer_array_begin(w);
+    g->first_seq = first_seq;
+    return true;
+}
+
+// Adds one line; a batch whose buffer is full is sent first.
+static void log_batch_add(ws_log_group_t* g, uint32_t seq, const char* line) {
+    if (!g->payload && !log_batch_begin(g, seq)) {
+        return;
+    }
+
+    json_writer_t saved = g->w;
+    json_writer_string(&g->w, line);
+    if (g->w.err != ESP_OK) {
+        g->w = saved;
+        broadcast_log_batch(g, seq);
+        if (!log_batch_begin(g, seq)) return;
+        json_writer_string(&g->w, line);  // one line always fits
+    }
 
-    for (size_t i = 0; i < cnt; ++i) {
-        ws_queue_send_text(fds[i], out);
+    if (++g->batched >= CONFIG_VE_WS_LOG_BATCH_LINES) {
+        broadcast_log_batch(g, seq + 1);
     }
-    free(out);
 }
 
-static int websocket_log_vprintf(const char* fmt, va_list ap) {
+static void ws_queue_history(int fd, uint32_t since, uint32_t upto);
+
+static void ws_flush_logs(void) {
+    // Clear first so lines pushed while we drain wake us again
+    atomic_store(&s_batch_pending, 0);
+
+    uint32_t oldest = log_capture_oldest_seq();
+    size_t req_count = 0;
+    size_t group_count = ws_clients_group_by_filter(
+        s_log_groups, s_history_reqs, &req_count, oldest);
+    if (group_count == 0) {
+        // Nobody listens; skip formatting, new clients get the history.
+        s_stream_seq = log_capture_next_seq();
+        return;
+    }
+
+    if ((int32_t)(s_stream_seq - oldest) < 0) {
+        s_stream_seq = oldest;  // we fell a full ring behind
+    }
+
+    // Histories end where this batch starts. httpd runs work items in order,
+    // so each history reaches its client before the batch does.
+    for (size_t i = 0; i < req_count; ++i) {
+        ws_queue_history(s_history_reqs[i].fd, s_history_reqs[i].since,
+                         s_stream_seq);
+    }
+
+    char line[LOG_LINE_MAX];
+    log_capture_meta_t meta;
+    while (s_stream_seq != log_capture_next_seq()) {
+        log_capture_result_t res =
+            log_capture_read(s_stream_seq, line, sizeof(line), &meta);
+        if (res == LOG_CAPTURE_PENDING) {
+            break;  // its producer wakes us again once it is done
+        }
+
+        uint32_t seq = s_stream_seq++;
+        if (res != LOG_CAPTURE_OK || !should_stream_log_line(line)) {
+            continue;
+        }
+
+        for (size_t k = 0; k < group_count; ++k) {
+            ws_log_group_t* g = &s_log_groups[k];
+            if (ws_log_filter_match(&g->filter, &meta, line)) {
+                log_batch_add(g, seq, line);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < group_count; ++k) {
+        if (s_log_groups[k].payload) {
+            broadcast_log_batch(&s_log_groups[k], s_stream_seq);
+        }
+    }
+}
+
+// Copies the telemetry subscriptions of all /ws clients. Returns the count.
+static size_t ws_clients_telemetry_snapshot(ws_telemetry_out_t* out) {
+    if (!s_ws_mutex) return 0;
+
+    size_t count = 0;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        const ws_client_t* c = &s_clients[i];
+        if (!c->active || c->sse_req || c->telemetry_count == 0) {
+            continue;
+        }
+        ws_telemetry_out_t* o = &out[count++];
+        o->fd = c->fd;
+        o->generation = c->generation;
+        o->sub_count = c->telemetry_count;
+        memcpy(o->subs, c->telemetry, c->telemetry_count * sizeof(o->subs[0]));
+        o->payload = NULL;
+    }
+    xSemaphoreGive(s_ws_mutex);
+    return count;
+}
+
+// Writes the rate limit state back, unless the client has resubscribed or
+// reconnected in the meantime.
+static void ws_clients_telemetry_commit(const ws_telemetry_out_t* out,
+                                        size_t count) {
+    if (count == 0) return;
+
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (size_t k = 0; k < count; ++k) {
+        for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+            ws_client_t* c = &s_clients[i];
+            if (!c->active || c->fd != out[k].fd ||
+                c->generation != out[k].generation) {
+                continue;
+            }
+            for (uint8_t j = 0; j < c->telemetry_count; ++j) {
+                for (uint8_t m = 0; m < out[k].sub_count; ++m) {
+                    if (c->telemetry[j].topic == out[k].subs[m].topic) {
+                        c->telemetry[j].next_due_us =
+                            out[k].subs[m].next_due_us;
+                    }
+                }
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(s_ws_mutex);
+}
+
+static uint8_t* put_le(uint8_t* p, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        *p++ = (uint8_t)(v >> (8 * i));
+    }
+    return p;
+}
+
+static void telemetry_frame_send(ws_telemetry_out_t* o) {
+    ws_payload_t* payload = o->payload;
+    o->payload = NULL;
+    (void)ws_queue_send_payload(o->fd, payload, 0);
+    ws_payload_release(payload);
+}
+
+// Appends a record to the client's frame; a frame that is full is sent first.
+static void telemetry_frame_add(ws_telemetry_out_t* o,
+                                const telemetry_record_t* rec) {
+    size_t need = TELEMETRY_RECORD_HEADER + rec->len;
+    if (o->payload) {
+        uint8_t count = (uint8_t)o->payload->data[1];
+        int64_t dt = rec->timestamp_us - o->base_us;
+        if (o->payload->len + need > WS_PAYLOAD_POOL_BUF ||
+            count == UINT8_MAX || dt < 0 || dt > UINT32_MAX) {
+            telemetry_frame_send(o);
+        }
+    }
+    if (!o->payload) {
+        o->payload = ws_payload_alloc();
+        if (!o->payload) return;
+        o->payload->binary = true;
+        o->base_us = rec->timestamp_us;
+
+        uint8_t* p = (uint8_t*)o->payload->data;
+        p = put_le(p, TELEMETRY_FRAME_VERSION, 1);
+        p = put_le(p, 0, 1);  // record count, updated per record
+        p = put_le(p, 0, 2);
+        put_le(p, (uint64_t)o->base_us, 8);
+        o->payload->len = TELEMETRY_FRAME_HEADER;
+    }
+
+    uint8_t* p = (uint8_t*)o->payload->data + o->payload->len;
+    p = put_le(p, rec->topic, 2);
+    p = put_le(p, rec->len, 2);
+    p = put_le(p, rec->seq, 4);
+    p = put_le(p, (uint64_t)(rec->timestamp_us - o->base_us), 4);
+    memcpy(p, rec->data, rec->len);
+    o->payload->len += need;
+    o->payload->data[1]++;
+}
+
+// Sends queued telemetry samples to their subscribers, one binary frame per
+// client and flush. Samples above a subscription's rate are skipped.
+static void ws_flush_telemetry(void) {
+    // Clear first so samples published while we drain wake us again
+    atomic_store(&s_telemetry_pending, 0);
+
+    size_t count = ws_clients_telemetry_snapshot(s_telemetry_out);
+    // Bounded, so a fast publisher cannot keep us here
+    for (int n = 0; n < CONFIG_VE_TELEMETRY_QUEUE_LEN; ++n) {
+        telemetry_record_t* rec = &s_telemetry_rec;
+        if (!telemetry_receive(rec)) break;
+
+        for (size_t k = 0; k < count; ++k) {
+            ws_telemetry_out_t* o = &s_telemetry_out[k];
+            for (uint8_t m = 0; m < o->sub_count; ++m) {
+                ws_telemetry_sub_t* sub = &o->subs[m];
+                if (sub->topic != rec->topic) continue;
+                if (rec->timestamp_us >= sub->next_due_us) {
+                    sub->next_due_us = rec->timestamp_us + sub->interval_us;
+                    telemetry_frame_add(o, rec);
+                }
+                break;
+            }
+        }
+    }
+
+    for (size_t k = 0; k < count; ++k) {
+        if (s_telemetry_out[k].payload) {
+            telemetry_frame_send(&s_telemetry_out[k]);
+        }
+    }
+    ws_clients_telemetry_commit(s_telemetry_out, count);
+}
+
+static void sse_keepalive_async(void* arg);
+
+#if CONFIG_VE_LOG_DEFERRED_CONSOLE
+static int console_printf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = s_orig_vprintf ? s_orig_vprintf(fmt, ap) : vprintf(fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+// Prints the captured lines on the console, so loggers do not have to format
+// them a second time. Lines overwritten before we get to them are counted.
+static void console_flush(void) {
     char line[LOG_LINE_MAX];
+    while (s_console_seq != log_capture_next_seq()) {
+        uint32_t oldest = log_capture_oldest_seq();
+        if ((int32_t)(s_console_seq - oldest) < 0) {
+            console_printf("... %lu log lines not printed\n",
+                           (unsigned long)(oldest - s_console_seq));
+            s_console_seq = oldest;
+        }
 
-    va_list ap_copy;
-    va_copy(ap_copy, ap);
-    vsnprintf(line, sizeof(line), fmt, ap_copy);
-    va_end(ap_copy);
+        log_capture_result_t res =
+            log_capture_read(s_console_seq, line, sizeof(line), NULL);
+        if (res == LOG_CAPTURE_PENDING) {
+            break;  // its producer wakes us again once it is done
+        }
+        s_console_seq++;
+        if (res == LOG_CAPTURE_OK) {
+            console_printf("%s\n", line);
+        }
+    }
+}
+#endif
+
+static void log_drain_task(void* arg) {
+    (void)arg;
+    for (;;) {
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SSE_KEEPALIVE_MS)) == 0) {
+            // Idle: make sure /events clients are still there
+            httpd_handle_t server = s_server_handle;
+            if (server && atomic_load(&s_sse_clients) > 0) {
+                (void)httpd_queue_work(server, sse_keepalive_async, NULL);
+            }
+            continue;
+        }
+#if CONFIG_VE_WS_LOG_BATCH_MS > 0
+        // Let a burst accumulate into one batch. The logger that fills the
+        // batch wakes us early.
+        if (atomic_load(&s_batch_pending) < CONFIG_VE_WS_LOG_BATCH_LINES &&
+            atomic_load(&s_telemetry_pending) <
+                CONFIG_VE_TELEMETRY_QUEUE_LEN / 2) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_VE_WS_LOG_BATCH_MS));
+        }
+#endif
+#if CONFIG_VE_LOG_DEFERRED_CONSOLE
+        console_flush();
+#endif
+        if (s_server_handle) {
+            ws_flush_logs();
+            ws_flush_telemetry();
+        } else {
+            atomic_store(&s_batch_pending, 0);
+            s_stream_seq = log_capture_next_seq();
+        }
+    }
+}
 
-    // Strip trailing newline to avoid double spacing on client
-    size_t len = strlen(line);
-    if (len && line[len - 1] == '\n') {
-        line[len - 1] = '\0';
+static void ws_wake_drain(void) {
+    TaskHandle_t task = s_drain_task;
+    if (!task) {
+        return;
+    }
+
+    // Only the first line of a batch and the one that fills it notify
+    uint32_t pending = atomic_fetch_add(&s_batch_pending, 1) + 1;
+    if (pending == 1 || pending == CONFIG_VE_WS_LOG_BATCH_LINES) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void websocket_telemetry_pending(void) {
+    TaskHandle_t task = s_drain_task;
+    if (!task) {
+        return;
     }
 
-    append_log_line(line);
-    if (should_stream_log_line(line)) {
-        broadcast_log_line(line);
+    // Like log lines: the first sample and a half full queue notify
+    uint32_t pending = atomic_fetch_add(&s_telemetry_pending, 1) + 1;
+    if (pending == 1 || pending == CONFIG_VE_TELEMETRY_QUEUE_LEN / 2) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static void log_stats_record(uint32_t us) {
+    atomic_fetch_add_explicit(&s_log_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_log_time_us, us, memory_order_relaxed);
+
+    uint32_t max =
+        atomic_load_explicit(&s_log_time_max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(
+                           &s_log_time_max_us, &max, us, memory_order_relaxed,
+                           memory_order_relaxed)) {
+    }
+}
+
+static int websocket_log_vprintf(const char* fmt, va_list ap) {
+    int64_t start = esp_timer_get_time();
+    bool captured = log_capture_vpush(fmt, ap);
+    ws_wake_drain();
+    log_stats_record((uint32_t)(esp_timer_get_time() - start));
+
+#if CONFIG_VE_LOG_DEFERRED_CONSOLE
+    // The drain task prints captured lines; only print a dropped one here
+    if (captured && s_drain_task) {
+        return 0;
     }
+#else
+    (void)captured;
+#endif
 
     if (s_orig_vprintf) {
         return s_orig_vprintf(fmt, ap);
@@ -330,36 +1329,284 @@ static int websocket_log_vprintf(const char* fmt, va_list ap) {
     return vprintf(fmt, ap);
 }
 
-static void send_log_history(int fd) {
-    ensure_mutex();
-    if (!s_ws_mutex) return;
+// Sends json_writer output as one fragmented text message, either on the
+// handler's request or asynchronously on `hd`/`fd`. With `sse_req` set, the
+// output becomes one SSE event instead, tagged with `event_id`.
+typedef struct {
+    httpd_req_t* req;
+    httpd_handle_t hd;
+    int fd;
+    httpd_req_t* sse_req;
+    uint32_t event_id;
+    bool started;
+    uint32_t sent;
+} ws_frame_sink_t;
+
+static esp_err_t sse_sink_flush(ws_frame_sink_t* sink, const char* data,
+                                size_t len, bool final) {
+    char fields[32] = "";
+    size_t n = 0;
+    if (!sink->started) {
+        n = (size_t)snprintf(fields, sizeof(fields), "id: %" PRIu32 "\ndata: ",
+                             sink->event_id);
+    }
+    const sse_piece_t pieces[] = {
+        {fields, n},
+        {data, len},
+        {"\n\n", final ? 2u : 0u},
+    };
+    esp_err_t err =
+        sse_send_chunk(sink->sse_req, pieces, sizeof(pieces) / sizeof(pieces[0]));
+    sink->started = true;
+    if (err == ESP_OK) {
+        sink->sent += len;
+    }
+    metrics_counter_inc(err == ESP_OK ? &s_frames_sent : &s_frames_dropped);
+    return err;
+}
+
+static esp_err_t ws_frame_sink_flush(void* ctx, const char* data, size_t len,
+                                     bool final) {
+    ws_frame_sink_t* sink = (ws_frame_sink_t*)ctx;
+    if (sink->sse_req) {
+        return sse_sink_flush(sink, data, len, final);
+    }
+
+    httpd_ws_frame_t frame = {
+        .final = final,
+        .fragmented = true,
+        .type = sink->started ? HTTPD_WS_TYPE_CONTINUE : HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t*)data,
+        .len = len,
+    };
+    esp_err_t err = sink->req
+                        ? httpd_ws_send_frame(sink->req, &frame)
+                        : httpd_ws_send_frame_async(sink->hd, sink->fd, &frame);
+    sink->started = true;
+    if (err == ESP_OK) {
+        sink->sent += len;
+    }
+    metrics_counter_inc(err == ESP_OK ? &s_frames_sent : &s_frames_dropped);
+    return err;
+}
+
+// History is streamed straight out of the ring as one fragmented text
+// message, so memory use does not grow with the history length.
+#define WS_HISTORY_CHUNK 1024
 
-    cJSON* root = cJSON_CreateObject();
-    if (!root) return;
+static char s_history_buf[WS_HISTORY_CHUNK];  // httpd task only
+
+static void ws_send_history_async(void* arg) {
+    ws_send_arg_t* a = (ws_send_arg_t*)arg;
+    if (!a) return;
 
-    cJSON_AddStringToObject(root, "type", "logs");
-    cJSON* arr = cJSON_AddArrayToObject(root, "lines");
-    if (!arr) {
-        cJSON_Delete(root);
+    httpd_req_t* sse_req = NULL;
+    if (!ws_client_lookup(a->fd, a->generation, &sse_req)) {
+        ws_clients_mark_send_done(a->fd, a->generation, 0, 0, 0);
+        ws_send_arg_free(a);
         return;
     }
 
-    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
-    size_t count = s_log_count;
-    size_t idx = (s_log_head + LOG_HISTORY_LINES - s_log_count) %
-                 LOG_HISTORY_LINES;  // oldest
-    for (size_t i = 0; i < count; ++i) {
-        cJSON_AddItemToArray(arr, cJSON_CreateString(s_log_lines[idx]));
-        idx = (idx + 1) % LOG_HISTORY_LINES;
+    // A cursor from the future (e.g. from before a reboot) gets the full
+    // history; a cursor that fell out of the ring gets a gap count.
+    uint32_t start = log_capture_oldest_seq();
+    uint32_t gap = 0;
+    bool append = a->since != 0 && (int32_t)(a->upto - a->since) >= 0;
+    if (append) {
+        if ((int32_t)(a->since - start) >= 0) {
+            start = a->since;
+        } else {
+            gap = start - a->since;
+        }
     }
-    xSemaphoreGive(s_ws_mutex);
 
-    char* out = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!out) return;
+    ws_log_filter_t filter;
+    ws_clients_get_filter(a->fd, &filter);
+
+    ws_frame_sink_t sink = {
+        .hd = a->hd, .fd = a->fd, .sse_req = sse_req, .event_id = a->upto};
+    json_writer_t w;
+    json_writer_init(&w, s_history_buf, sizeof(s_history_buf),
+                     ws_frame_sink_flush, &sink);
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "type", "logs");
+    if (append) {
+        json_writer_kv_bool(&w, "append", true);
+    }
+    json_writer_key(&w, "lines");
+    json_writer_array_begin(&w);
+
+    // Stop at the stream cursor the drain task handed us: everything after it
+    // reaches this client through the regular batches.
+    char line[LOG_LINE_MAX];
+    log_capture_meta_t meta;
+    for (uint32_t seq = start;
+         (int32_t)(a->upto - seq) > 0 && w.err == ESP_OK; ++seq) {
+        if (log_capture_read(seq, line, sizeof(line), &meta) !=
+            LOG_CAPTURE_OK) {
+            gap++;
+            continue;
+        }
+        if (ws_log_filter_match(&filter, &meta, line)) {
+            json_writer_string(&w, line);
+        }
+    }
+
+    json_writer_array_end(&w);
+    json_writer_kv_uint(&w, "next", a->upto);
+    if (append && gap > 0) {
+        json_writer_kv_uint(&w, "gap", gap);
+    }
+    json_writer_object_end(&w);
+    esp_err_t err = json_writer_finish(&w);
 
-    ws_queue_send_text(fd, out);
-    free(out);
+    ws_clients_mark_send_done(a->fd, a->generation, 0, sink.sent,
+                              a->queued_at);
+    if (err != ESP_OK) {
+        // A partial message leaves the stream unusable
+        ws_trigger_close_if_current(a->fd, a->generation);
+    }
+    ws_send_arg_free(a);
+}
+
+// Queues the history stream [since, upto) for one client.
+static void ws_queue_history(int fd, uint32_t since, uint32_t upto) {
+    httpd_handle_t server = s_server_handle;
+    if (!server) return;
+
+    uint32_t generation = 0;
+    if (!ws_clients_reserve_send(fd, 0, 0, &generation)) {
+        return;
+    }
+
+    ws_send_arg_t* arg = ws_send_arg_alloc();
+    if (!arg) {
+        ws_clients_mark_send_done(fd, generation, 0, 0, 0);
+        return;
+    }
+
+    arg->hd = server;
+    arg->fd = fd;
+    arg->generation = generation;
+    arg->payload = NULL;
+    arg->since = since;
+    arg->upto = upto;
+    arg->reserved = 0;
+    arg->queued_at = esp_timer_get_time();
+
+    if (httpd_queue_work(server, ws_send_history_async, arg) != ESP_OK) {
+        ws_send_arg_free(arg);
+        ws_clients_mark_send_done(fd, generation, 0, 0, 0);
+    }
+}
+
+// Requests the log history for one client. With `since` != 0 only lines from
+// that sequence number on are sent, as an append.
+static void send_log_history(int fd, uint32_t since) {
+    if (!s_drain_task) {
+        // No live stream without the drain task, the history is all we have
+        ws_queue_history(fd, since, log_capture_next_seq());
+        return;
+    }
+
+    if (ws_clients_request_history(fd, since)) {
+        xTaskNotifyGive(s_drain_task);
+    }
+}
+
+// Reads the resume cursor from "/ws?since=<seq>", 0 if absent.
+static uint32_t ws_query_since(httpd_req_t* req) {
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "since", value, sizeof(value)) !=
+            ESP_OK) {
+        return 0;
+    }
+    return (uint32_t)strtoul(value, NULL, 10);
+}
+
+static bool ws_filter_add_tags(const cJSON* arr, uint32_t* hashes,
+                               uint8_t* count) {
+    if (!arr) return true;
+    if (!cJSON_IsArray(arr)) return false;
+
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, arr) {
+        if (!cJSON_IsString(item) || !item->valuestring ||
+            *count >= WS_FILTER_MAX_TAGS) {
+            return false;
+        }
+        hashes[(*count)++] = log_capture_tag_hash(item->valuestring);
+    }
+    return true;
+}
+
+// Parses {"type":"subscribe","level":"W","tags":[...],"exclude":[...],
+// "match":"..."}. Omitted fields do not filter.
+static bool ws_filter_from_json(const cJSON* root, ws_log_filter_t* filter) {
+    memset(filter, 0, sizeof(*filter));
+
+    const cJSON* level = cJSON_GetObjectItem(root, "level");
+    if (cJSON_IsString(level) && level->valuestring) {
+        const char* letters = "EWIDV";
+        const char* p = level->valuestring[0]
+                            ? strchr(letters, level->valuestring[0])
+                            : NULL;
+        if (!p) return false;
+        filter->max_level = (uint8_t)(p - letters + 1);
+    } else if (cJSON_IsNumber(level)) {
+        if (level->valuedouble < 0 || level->valuedouble > ESP_LOG_VERBOSE) {
+            return false;
+        }
+        filter->max_level = (uint8_t)level->valuedouble;
+    } else if (level) {
+        return false;
+    }
+
+    if (!ws_filter_add_tags(cJSON_GetObjectItem(root, "tags"), filter->include,
+                            &filter->include_count) ||
+        !ws_filter_add_tags(cJSON_GetObjectItem(root, "exclude"),
+                            filter->exclude, &filter->exclude_count)) {
+        return false;
+    }
+
+    const cJSON* match = cJSON_GetObjectItem(root, "match");
+    if (cJSON_IsString(match) && match->valuestring) {
+        if (strlen(match->valuestring) >= sizeof(filter->match)) return false;
+        strcpy(filter->match, match->valuestring);
+    } else if (match) {
+        return false;
+    }
+    return true;
+}
+
+// Parses {"type":"telemetry-subscribe","topics":[{"id":1,"max_hz":50},...]}.
+// A topic without "max_hz" (or 0) gets every sample; an empty list
+// unsubscribes.
+static bool ws_telemetry_from_json(const cJSON* root, ws_telemetry_sub_t* subs,
+                                   uint8_t* count) {
+    *count = 0;
+    const cJSON* topics = cJSON_GetObjectItem(root, "topics");
+    if (!cJSON_IsArray(topics)) return false;
+
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, topics) {
+        const cJSON* id = cJSON_GetObjectItem(item, "id");
+        const cJSON* hz = cJSON_GetObjectItem(item, "max_hz");
+        if (*count >= WS_TELEMETRY_MAX_SUBS || !cJSON_IsNumber(id) ||
+            id->valuedouble < 0 || id->valuedouble > UINT16_MAX ||
+            (hz && (!cJSON_IsNumber(hz) || hz->valuedouble < 0))) {
+            return false;
+        }
+        ws_telemetry_sub_t* sub = &subs[(*count)++];
+        sub->topic = (uint16_t)id->valuedouble;
+        sub->interval_us = hz && hz->valuedouble > 0
+                               ? (uint32_t)(1000000.0 / hz->valuedouble)
+                               : 0;
+        sub->next_due_us = 0;
+    }
+    return true;
 }
 
 static esp_err_t ws_send_text(httpd_req_t* req, const char* text) {
@@ -380,12 +1627,19 @@ static esp_err_t websocket_handler(httpd_req_t* req) {
 
     // Handshake call
     if (req->method == HTTP_GET) {
-        uint32_t generation = ws_clients_add(fd);
+        uint32_t generation = ws_clients_add(fd, NULL);
         if (generation == 0) {
             httpd_sess_trigger_close(req->handle, fd);
             return ESP_FAIL;
         }
-        send_log_history(fd);
+        send_log_history(fd, ws_query_since(req));
+
+        // Start the client off with the current /info; changes follow as
+        // "info" messages so the page does not have to poll.
+        char info[INFO_SNAPSHOT_MESSAGE_MAX];
+        if (info_snapshot_message(info, sizeof(info)) == ESP_OK) {
+            (void)ws_queue_send_text(fd, info);
+        }
         ESP_LOGI(TAG_WS, "WebSocket client connected: fd=%d", fd);
         return ESP_OK;
     }
@@ -450,7 +1704,68 @@ static esp_err_t websocket_handler(httpd_req_t* req) {
     cJSON* type = cJSON_GetObjectItem(root, "type");
     if (cJSON_IsString(type) && type->valuestring &&
         strcmp(type->valuestring, "get-logs") == 0) {
-        send_log_history(fd);
+        cJSON* since = cJSON_GetObjectItem(root, "since");
+        send_log_history(fd, cJSON_IsNumber(since) && since->valuedouble >= 1
+                                 ? (uint32_t)since->valuedouble
+                                 : 0);
+    } else if (cJSON_IsString(type) && type->valuestring &&
+               strcmp(type->valuestring, "subscribe") == 0) {
+        ws_log_filter_t filter;
+        if (ws_filter_from_json(root, &filter)) {
+            ws_clients_set_filter(fd, &filter);
+            ws_send_text(req, "{\"type\":\"subscribed\"}");
+        } else {
+            ws_send_text(
+                req, "{\"type\":\"error\",\"msg\":\"invalid subscription\"}");
+        }
+    } else if (cJSON_IsString(type) && type->valuestring &&
+               strcmp(type->valuestring, "log-stats") == 0) {
+        websocket_log_stats_t stats;
+        websocket_get_log_stats(&stats);
+        char reply[160];
+        snprintf(reply, sizeof(reply),
+                 "{\"type\":\"log-stats\",\"calls\":%" PRIu32
+                 ",\"total_us\":%" PRIu32 ",\"max_us\":%" PRIu32
+                 ",\"dropped\":%" PRIu32 "}",
+                 stats.calls, stats.total_us, stats.max_us, stats.dropped);
+        ws_send_text(req, reply);
+    } else if (cJSON_IsString(type) && type->valuestring &&
+               strcmp(type->valuestring, "ws-stats") == 0) {
+        char buf[JSON_WRITER_HTTP_BUF];
+        ws_frame_sink_t sink = {.req = req};
+        json_writer_t w;
+        json_writer_init(&w, buf, sizeof(buf), ws_frame_sink_flush, &sink);
+        ws_clients_write_stats(&w, fd);
+        json_writer_finish(&w);
+    } else if (cJSON_IsString(type) && type->valuestring &&
+               strcmp(type->valuestring, "telemetry-subscribe") == 0) {
+        ws_telemetry_sub_t subs[WS_TELEMETRY_MAX_SUBS];
+        uint8_t count = 0;
+        if (ws_telemetry_from_json(root, subs, &count)) {
+            ws_clients_set_telemetry(fd, subs, count);
+            char reply[64];
+            snprintf(reply, sizeof(reply),
+                     "{\"type\":\"telemetry-subscribed\",\"count\":%u}",
+                     (unsigned)count);
+            ws_send_text(req, reply);
+        } else {
+            ws_send_text(req,
+                         "{\"type\":\"error\",\"msg\":\"invalid telemetry "
+                         "subscription\"}");
+        }
+    } else if (cJSON_IsString(type) && type->valuestring &&
+               strcmp(type->valuestring, "telemetry-topics") == 0) {
+        char buf[JSON_WRITER_HTTP_BUF];
+        ws_frame_sink_t sink = {.req = req};
+        json_writer_t w;
+        json_writer_init(&w, buf, sizeof(buf), ws_frame_sink_flush, &sink);
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "type", "telemetry-topics");
+        json_writer_kv_uint(&w, "max_payload", CONFIG_VE_TELEMETRY_MAX_PAYLOAD);
+        json_writer_key(&w, "topics");
+        telemetry_write_topics(&w);
+        json_writer_object_end(&w);
+        json_writer_finish(&w);
     } else if (cJSON_IsString(type) && type->valuestring &&
                strcmp(type->valuestring, "ping") == 0) {
         ws_send_text(req, "{\"type\":\"pong\"}");
@@ -464,24 +1779,241 @@ static esp_err_t websocket_handler(httpd_req_t* req) {
     return ESP_OK;
 }
 
+// Sends a comment line to every /events client; one that is gone fails the
+// write and is closed.
+static void sse_keepalive_async(void* arg) {
+    (void)arg;
+    if (!s_ws_mutex) return;
+
+    int fds[MAX_WS_CLIENTS];
+    uint32_t gens[MAX_WS_CLIENTS];
+    httpd_req_t* reqs[MAX_WS_CLIENTS];
+    size_t count = 0;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        const ws_client_t* c = &s_clients[i];
+        // A client with sends in flight is already being probed
+        if (c->active && c->sse_req && c->pending_sends == 0) {
+            fds[count] = c->fd;
+            gens[count] = c->generation;
+            reqs[count] = c->sse_req;
+            count++;
+        }
+    }
+    xSemaphoreGive(s_ws_mutex);
+
+    static const sse_piece_t ping = {":\n\n", 3};
+    for (size_t i = 0; i < count; ++i) {
+        if (sse_send_chunk(reqs[i], &ping, 1) != ESP_OK) {
+            ws_trigger_close_if_current(fds[i], gens[i]);
+        }
+    }
+}
+
+static bool ws_clients_have_room(void) {
+    if (!ensure_mutex()) return false;
+
+    bool room = false;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS && !room; ++i) {
+        room = !s_clients[i].active;
+    }
+    xSemaphoreGive(s_ws_mutex);
+    return room;
+}
+
+// Resume cursor of an EventSource reconnect, else "?since=", else 0.
+static uint32_t sse_last_event_id(httpd_req_t* req) {
+    char value[12];
+    if (httpd_req_get_hdr_value_str(req, "Last-Event-ID", value,
+                                    sizeof(value)) == ESP_OK) {
+        return (uint32_t)strtoul(value, NULL, 10);
+    }
+    return ws_query_since(req);
+}
+
+// GET /events: the log stream and status messages of /ws as Server-Sent
+// Events, for clients that only listen. The request is detached from the
+// handler and kept open; the drain task and broadcasts write to it through
+// the same client table, budgets and catch-up rules as websocket clients.
+static esp_err_t sse_handler(httpd_req_t* req) {
+    int fd = httpd_req_to_sockfd(req);
+    uint32_t since = sse_last_event_id(req);
+    if (!ws_clients_have_room()) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        return httpd_resp_sendstr(req, "Too many log clients");
+    }
+
+    httpd_req_t* sse_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &sse_req);
+    if (err != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   "Could not open event stream");
+    }
+
+    // The first chunk carries the headers
+    httpd_resp_set_type(sse_req, "text/event-stream");
+    httpd_resp_set_hdr(sse_req, "Cache-Control", "no-cache");
+    err = httpd_resp_send_chunk(sse_req, SSE_RETRY, strlen(SSE_RETRY));
+    uint32_t generation = err == ESP_OK ? ws_clients_add(fd, sse_req) : 0;
+    if (generation == 0) {
+        httpd_req_async_handler_complete(sse_req);
+        httpd_sess_trigger_close(req->handle, fd);
+        return ESP_OK;
+    }
+
+    send_log_history(fd, since);
+    char info[INFO_SNAPSHOT_MESSAGE_MAX];
+    if (info_snapshot_message(info, sizeof(info)) == ESP_OK) {
+        (void)ws_queue_send_text(fd, info);
+    }
+    ESP_LOGI(TAG_WS, "SSE client connected: fd=%d", fd);
+    return ESP_OK;
+}
+
 void websocket_init_log_capture(void) {
     if (s_orig_vprintf) {
         return;  // already hooked
     }
 
-    s_orig_vprintf = esp_log_set_vprintf(websocket_log_vprintf);
     ensure_mutex();
+    if (!s_drain_task) {
+#if CONFIG_VE_LOG_DEFERRED_CONSOLE
+        s_console_seq = log_capture_next_seq();
+#endif
+#if CONFIG_FREERTOS_UNICORE || CONFIG_VE_LOG_DRAIN_TASK_CORE < 0
+        BaseType_t core = tskNO_AFFINITY;
+#else
+        BaseType_t core = CONFIG_VE_LOG_DRAIN_TASK_CORE;
+#endif
+        if (xTaskCreatePinnedToCore(log_drain_task, "ve_log_drain",
+                                    CONFIG_VE_LOG_DRAIN_TASK_STACK, NULL,
+                                    CONFIG_VE_LOG_DRAIN_TASK_PRIORITY,
+                                    &s_drain_task, core) != pdPASS) {
+            s_drain_task = NULL;
+            ESP_LOGE(TAG_WS, "log drain task create failed, streaming off");
+        }
+    }
+    s_orig_vprintf = esp_log_set_vprintf(websocket_log_vprintf);
+}
+
+void websocket_broadcast(const char* text) {
+    if (!s_server_handle || !s_ws_mutex || !text) {
+        return;
+    }
+
+    int fds[MAX_WS_CLIENTS];
+    size_t count = 0;
+    xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        if (s_clients[i].active) {
+            fds[count++] = s_clients[i].fd;
+        }
+    }
+    xSemaphoreGive(s_ws_mutex);
+    if (count == 0) {
+        return;
+    }
+
+    // One payload shared by every client's send
+    ws_payload_t* payload = ws_payload_from_text(text);
+    if (!payload) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        (void)ws_queue_send_payload(fds[i], payload, 0);
+    }
+    ws_payload_release(payload);
+}
+
+void websocket_write_metrics(metrics_out_t* out) {
+    uint32_t clients = 0;
+    uint32_t sse_clients = 0;
+    uint32_t coalescing = 0;
+    uint32_t pending = 0;
+    uint32_t queued_bytes = 0;
+    if (s_ws_mutex) {
+        xSemaphoreTake(s_ws_mutex, portMAX_DELAY);
+        for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+            const ws_client_t* c = &s_clients[i];
+            if (!c->active) {
+                continue;
+            }
+            clients++;
+            sse_clients += c->sse_req != NULL;
+            coalescing += c->flow == WS_FLOW_COALESCE;
+            pending += c->pending_sends;
+            queued_bytes += c->queued_bytes;
+        }
+        xSemaphoreGive(s_ws_mutex);
+    }
+
+    metrics_family(out, "ve_ws_clients", "gauge",
+                   "Connected log stream clients, /ws and /events");
+    metrics_sample(out, "ve_ws_clients", NULL, clients);
+    metrics_family(out, "ve_sse_clients", "gauge",
+                   "Connected /events clients");
+    metrics_sample(out, "ve_sse_clients", NULL, sse_clients);
+    metrics_family(out, "ve_ws_clients_coalescing", "gauge",
+                   "Clients waiting for a log catch-up");
+    metrics_sample(out, "ve_ws_clients_coalescing", NULL, coalescing);
+    metrics_family(out, "ve_ws_queue_depth", "gauge",
+                   "Sends queued on httpd for all clients");
+    metrics_sample(out, "ve_ws_queue_depth", NULL, pending);
+    metrics_family(out, "ve_ws_queued_bytes", "gauge",
+                   "Bytes queued on httpd for all clients");
+    metrics_sample(out, "ve_ws_queued_bytes", NULL, queued_bytes);
+
+    metrics_family(out, "ve_ws_frames_sent_total", "counter",
+                   "Websocket frames written");
+    metrics_sample(out, "ve_ws_frames_sent_total", NULL,
+                   metrics_counter_read(&s_frames_sent));
+    metrics_family(out, "ve_ws_frames_dropped_total", "counter",
+                   "Websocket frames refused or failed");
+    metrics_sample(out, "ve_ws_frames_dropped_total", NULL,
+                   metrics_counter_read(&s_frames_dropped));
+    metrics_family(out, "ve_ws_batches_skipped_total", "counter",
+                   "Log batches left to a catch-up for a slow client");
+    metrics_sample(out, "ve_ws_batches_skipped_total", NULL,
+                   metrics_counter_read(&s_batches_skipped));
+
+    websocket_log_stats_t stats;
+    websocket_get_log_stats(&stats);
+    metrics_family(out, "ve_log_calls_total", "counter",
+                   "Log calls seen by the capture hook");
+    metrics_sample(out, "ve_log_calls_total", NULL, stats.calls);
+    metrics_family(out, "ve_log_dropped_total", "counter",
+                   "Lines the capture ring had to drop");
+    metrics_sample(out, "ve_log_dropped_total", NULL, stats.dropped);
+}
+
+void websocket_get_log_stats(websocket_log_stats_t* out) {
+    if (!out) return;
+    out->calls = atomic_load_explicit(&s_log_calls, memory_order_relaxed);
+    out->total_us = atomic_load_explicit(&s_log_time_us, memory_order_relaxed);
+    out->max_us =
+        atomic_load_explicit(&s_log_time_max_us, memory_order_relaxed);
+    out->dropped = log_capture_dropped();
 }
 
-void websocket_client_closed(int fd) { ws_clients_remove(fd); }
+void websocket_client_closed(int fd) {
+    httpd_req_t* sse_req = NULL;
+    if (ws_clients_remove_generation(fd, 0, &sse_req) && sse_req) {
+        // httpd is closing the socket under the detached request
+        httpd_req_async_handler_complete(sse_req);
+    }
+}
 
 /**
  * ✅ This symbol must exist (non-static), because your http_server.c links
  * against it.
  */
 esp_err_t websocket_register_handlers(httpd_handle_t server) {
-    s_server_handle = server;
     websocket_init_log_capture();
+    // Lines from before the server existed are only replayed as history: the
+    // drain task skips to the ring head while no client is connected.
+    s_server_handle = server;
 
     httpd_uri_t ws = {
         .uri = "/ws",
@@ -491,12 +2023,24 @@ esp_err_t websocket_register_handlers(httpd_handle_t server) {
         .is_websocket = true,
     };
 
-    esp_err_t ret = httpd_register_uri_handler(server, &ws);
+    esp_err_t ret = http_server_register_uri(server, &ws);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG_WS, "register ws handler failed: %d", ret);
         return ret;
     }
 
     ESP_LOGI(TAG_WS, "ws handler registered at %s", ws.uri);
+
+    static const httpd_uri_t events = {
+        .uri = "/events",
+        .method = HTTP_GET,
+        .handler = sse_handler,
+        .user_ctx = NULL,
+    };
+    ret = http_server_register_uri(server, &events);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG_WS, "register SSE handler failed: %d", ret);
+        return ret;
+    }
     return ESP_OK;
 }
@@ -0,0 +1,23 @@
+#include "http_cache.h"
+#include "unity.h"
+
+TEST_CASE("gzip is accepted when listed or covered by a wildcard",
+          "[http_cache]") {
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip(NULL));
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip("gzip"));
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip("gzip, deflate, br, zstd"));
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip("br;q=1.0, GZIP;q=0.5"));
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip("x-gzip"));
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip("*"));
+    TEST_ASSERT_TRUE(http_cache_accepts_gzip("identity, *;q=0.1"));
+}
+
+TEST_CASE("gzip is refused when missing or excluded", "[http_cache]") {
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip(""));
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip("identity"));
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip("br, deflate"));
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip("gzip;q=0"));
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip("gzip; q=0.000, br"));
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip("*, gzip;q=0"));
+    TEST_ASSERT_FALSE(http_cache_accepts_gzip("*;q=0"));
+}
@@ -0,0 +1,166 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "http_router.h"
+#include "sdkconfig.h"
+#include "unity.h"
+
+// The router has no way to remove routes, so every test uses its own first
+// segment and stays well below CONFIG_VE_HTTP_MAX_ENDPOINTS.
+
+static void assert_param(const char* pattern,
+                         const http_router_params_t* params, const char* uri,
+                         const char* name, const char* expected) {
+    const char* value = NULL;
+    size_t len = 0;
+    TEST_ASSERT_TRUE_MESSAGE(
+        http_router_param(pattern, params, uri, name, &value, &len), name);
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(strlen(expected), len, name);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, value, len, name);
+}
+
+TEST_CASE("router prefers literal segments and backtracks to a parameter",
+          "[http_router]") {
+    static int by_id, list_all;
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_init());
+    TEST_ASSERT_EQUAL(ESP_OK,
+                      http_router_add("/rt/{id}/name", HTTP_GET, &by_id));
+    TEST_ASSERT_EQUAL(ESP_OK,
+                      http_router_add("/rt/list/all", HTTP_GET, &list_all));
+
+    http_router_params_t params;
+    TEST_ASSERT_EQUAL_PTR(
+        &list_all, http_router_match("/rt/list/all", HTTP_GET, NULL, &params));
+    TEST_ASSERT_EQUAL(0, params.count);
+
+    // "list" matches literally first, but has no "name" child
+    const char* uri = "/rt/list/name";
+    TEST_ASSERT_EQUAL_PTR(&by_id,
+                          http_router_match(uri, HTTP_GET, NULL, &params));
+    TEST_ASSERT_EQUAL(1, params.count);
+    assert_param("/rt/{id}/name", &params, uri, "id", "list");
+
+    uri = "/rt/7/name?verbose=1";
+    TEST_ASSERT_EQUAL_PTR(&by_id,
+                          http_router_match(uri, HTTP_GET, NULL, &params));
+    assert_param("/rt/{id}/name", &params, uri, "id", "7");
+
+    TEST_ASSERT_NULL(http_router_match("/rt/list", HTTP_GET, NULL, &params));
+    TEST_ASSERT_NULL(
+        http_router_match("/rt/7/name/x", HTTP_GET, NULL, &params));
+}
+
+TEST_CASE("router tells 405 from 404 and falls back to HTTP_ANY",
+          "[http_router]") {
+    static int get_x, any_y, get_y;
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_init());
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_add("/rm/x", HTTP_GET, &get_x));
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_add("/rm/y", HTTP_ANY, &any_y));
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_add("/rm/y", HTTP_GET, &get_y));
+
+    bool known = false;
+    TEST_ASSERT_NULL(http_router_match("/rm/x", HTTP_POST, &known, NULL));
+    TEST_ASSERT_TRUE(known);
+    TEST_ASSERT_NULL(http_router_match("/rm/z", HTTP_GET, &known, NULL));
+    TEST_ASSERT_FALSE(known);
+
+    TEST_ASSERT_EQUAL_PTR(&get_y,
+                          http_router_match("/rm/y", HTTP_GET, NULL, NULL));
+    TEST_ASSERT_EQUAL_PTR(&any_y,
+                          http_router_match("/rm/y", HTTP_DELETE, NULL, NULL));
+}
+
+TEST_CASE("router captures every parameter of a match", "[http_router]") {
+    static int route;
+    const char* pattern = "/rp/{sensor}/reg/{reg}";
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_init());
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_add(pattern, HTTP_PUT, &route));
+
+    // Repeated and trailing slashes do not count as segments
+    const char* uri = "//rp/temp%201/reg/0x0F/";
+    http_router_params_t params;
+    TEST_ASSERT_EQUAL_PTR(&route,
+                          http_router_match(uri, HTTP_PUT, NULL, &params));
+    TEST_ASSERT_EQUAL(2, params.count);
+    assert_param(pattern, &params, uri, "sensor", "temp%201");
+    assert_param(pattern, &params, uri, "reg", "0x0F");
+
+    const char* value;
+    size_t len;
+    TEST_ASSERT_FALSE(
+        http_router_param(pattern, &params, uri, "id", &value, &len));
+    TEST_ASSERT_FALSE(
+        http_router_param(pattern, &params, uri, "regs", &value, &len));
+}
+
+TEST_CASE("router rejects invalid and duplicate patterns", "[http_router]") {
+    static int route;
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_init());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      http_router_add("rd", HTTP_GET, &route));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      http_router_add("/rd/a{b}", HTTP_GET, &route));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      http_router_add("/rd/{a}{b}", HTTP_GET, &route));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      http_router_add("/rd/{}", HTTP_GET, &route));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      http_router_add("/rd/x?y", HTTP_GET, &route));
+    TEST_ASSERT_EQUAL(
+        ESP_ERR_INVALID_ARG,
+        http_router_add("/{a}/{b}/{c}/{d}/{e}/{f}/{g}/{h}/{i}", HTTP_GET,
+                        &route));
+
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_add("/rd/{x}", HTTP_GET, &route));
+    // Parameter names do not make a pattern different
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE,
+                      http_router_add("/rd/{y}", HTTP_GET, &route));
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_add("/rd/{y}", HTTP_POST, &route));
+}
+
+// Fills the router, so it runs last
+TEST_CASE("router leaves the trie unchanged when a route does not fit",
+          "[http_router]") {
+    static int route;
+    TEST_ASSERT_EQUAL(ESP_OK, http_router_init());
+
+    // More segments than there are nodes left; like http_server, free the
+    // pattern of a route that was not added
+    char long_path[4 * (3 * CONFIG_VE_HTTP_MAX_ENDPOINTS + 2) + 4] = "/rn";
+    for (size_t len = 3; len + 4 < sizeof(long_path); len += 2) {
+        strcat(long_path, "/x");
+    }
+    char* pattern = strdup(long_path);
+    TEST_ASSERT_NOT_NULL(pattern);
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM,
+                      http_router_add(pattern, HTTP_GET, &route));
+    free(pattern);
+
+    int added = 0;
+    esp_err_t err;
+    do {
+        char path[16];
+        snprintf(path, sizeof(path), "/rc/%d", added);
+        pattern = strdup(path);
+        TEST_ASSERT_NOT_NULL(pattern);
+        err = http_router_add(pattern, HTTP_GET, &route);
+        if (err == ESP_OK) {
+            added++;
+        } else {
+            free(pattern);
+        }
+    } while (err == ESP_OK && added <= CONFIG_VE_HTTP_MAX_ENDPOINTS);
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, err);
+    TEST_ASSERT_GREATER_THAN(0, added);
+
+    // Would read the freed patterns if their nodes had stayed in the trie
+    TEST_ASSERT_EQUAL_PTR(&route,
+                          http_router_match("/rc/0", HTTP_GET, NULL, NULL));
+    TEST_ASSERT_NULL(http_router_match("/rn/x/x", HTTP_GET, NULL, NULL));
+    char path[16];
+    snprintf(path, sizeof(path), "/rc/%d", added);
+    TEST_ASSERT_NULL(http_router_match(path, HTTP_GET, NULL, NULL));
+}
@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "json_writer.h"
+#include "unity.h"
+
+typedef struct {
+    char out[256];
+    size_t len;
+    int flushes;
+    bool final;
+} sink_t;
+
+static esp_err_t sink_flush(void* ctx, const char* data, size_t len,
+                            bool final) {
+    sink_t* sink = (sink_t*)ctx;
+    if (sink->len + len >= sizeof(sink->out)) return ESP_FAIL;
+    memcpy(sink->out + sink->len, data, len);
+    sink->len += len;
+    sink->out[sink->len] = '\0';
+    sink->flushes++;
+    sink->final = final;
+    return ESP_OK;
+}
+
+TEST_CASE("json writer separates members and elements", "[json_writer]") {
+    char buf[128];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    json_writer_object_begin(&w);
+    json_writer_kv_int(&w, "a", -1);
+    json_writer_kv_uint(&w, "b", 18446744073709551615ull);
+    json_writer_key(&w, "c");
+    json_writer_array_begin(&w);
+    json_writer_bool(&w, true);
+    json_writer_null(&w);
+    json_writer_object_begin(&w);
+    json_writer_object_end(&w);
+    json_writer_array_begin(&w);
+    json_writer_array_end(&w);
+    json_writer_string(&w, NULL);
+    json_writer_array_end(&w);
+    json_writer_kv_bool(&w, "d", false);
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"a\":-1,\"b\":18446744073709551615,"
+        "\"c\":[true,null,{},[],null],\"d\":false}",
+        buf);
+}
+
+TEST_CASE("json writer escapes quotes, backslashes and control characters",
+          "[json_writer]") {
+    char buf[128];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "k\"ey", "a\"b\\c\nd\re\tf\x01g\x1f");
+    json_writer_kv_string(&w, "utf8", "\xc2\xb5s");
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"k\\\"ey\":\"a\\\"b\\\\c\\nd\\re\\tf\\u0001g\\u001f\","
+        "\"utf8\":\"\xc2\xb5s\"}",
+        buf);
+}
+
+TEST_CASE("json writer stops at the depth limit", "[json_writer]") {
+    char buf[128];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH - 1; ++i) {
+        json_writer_array_begin(&w);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, w.err);
+    json_writer_array_begin(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, w.err);
+
+    // Sticky: later writes do nothing
+    size_t len = w.len;
+    json_writer_array_end(&w);
+    TEST_ASSERT_EQUAL(len, w.len);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, json_writer_finish(&w));
+}
+
+TEST_CASE("json writer rejects unbalanced closes", "[json_writer]") {
+    char buf[16];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, json_writer_finish(&w));
+}
+
+TEST_CASE("json writer fails when the output does not fit the buffer",
+          "[json_writer]") {
+    char buf[8];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    json_writer_string(&w, "0123456789");
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, json_writer_finish(&w));
+}
+
+TEST_CASE("json writer streams through a small buffer", "[json_writer]") {
+    sink_t sink = {0};
+    char buf[4];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), sink_flush, &sink);
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "name", "a\"long\"value");
+    json_writer_object_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+    TEST_ASSERT_EQUAL_STRING("{\"name\":\"a\\\"long\\\"value\"}", sink.out);
+    TEST_ASSERT_GREATER_THAN(1, sink.flushes);
+    TEST_ASSERT_TRUE(sink.final);
+}
+
+TEST_CASE("json writer fails on stringf output past its limit",
+          "[json_writer]") {
+    char buf[128];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    json_writer_array_begin(&w);
+    json_writer_stringf(&w, "0x%02X", 0x6A);
+    json_writer_stringf(&w, "%0*d", JSON_WRITER_STRINGF_MAX, 7);
+    TEST_ASSERT_EQUAL(ESP_OK, w.err);
+    json_writer_stringf(&w, "%0*d", JSON_WRITER_STRINGF_MAX + 1, 7);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, json_writer_finish(&w));
+    TEST_ASSERT_EQUAL_STRING_LEN("[\"0x6A\",\"0000", buf, 13);
+}
@@ -0,0 +1,73 @@
+#include <stdint.h>
+
+#include "latency_hist.h"
+#include "unity.h"
+
+TEST_CASE("latency histogram puts durations into power of two buckets",
+          "[latency_hist]") {
+    latency_hist_t h = {0};
+    latency_hist_record(&h, 0);
+    latency_hist_record(&h, 32);  // at most 32 us
+    latency_hist_record(&h, 33);  // at most 64 us
+    latency_hist_record(&h, 64);
+    latency_hist_record(&h, 65);        // at most 128 us
+    latency_hist_record(&h, 16777216);  // the last bounded bucket
+    latency_hist_record(&h, 16777217);  // above every bound
+    latency_hist_record(&h, UINT32_MAX);
+
+    TEST_ASSERT_EQUAL_UINT32(2, h.buckets[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, h.buckets[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.buckets[2]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.buckets[LATENCY_HIST_BUCKETS - 2]);
+    TEST_ASSERT_EQUAL_UINT32(2, h.buckets[LATENCY_HIST_BUCKETS - 1]);
+    TEST_ASSERT_EQUAL_UINT32(8, latency_hist_count(&h));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, h.max_us);
+    TEST_ASSERT_EQUAL_UINT32(32, latency_hist_bucket_bound(0));
+    TEST_ASSERT_EQUAL_UINT32(16777216,
+                             latency_hist_bucket_bound(LATENCY_HIST_BUCKETS -
+                                                       2));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX,
+                             latency_hist_bucket_bound(LATENCY_HIST_BUCKETS -
+                                                       1));
+}
+
+TEST_CASE("latency histogram sums the recorded durations",
+          "[latency_hist]") {
+    latency_hist_t h = {0};
+    latency_hist_record(&h, UINT32_MAX);
+    latency_hist_record(&h, UINT32_MAX);
+    latency_hist_record(&h, 10);
+    TEST_ASSERT_TRUE(h.sum_us == 2ull * UINT32_MAX + 10);
+}
+
+TEST_CASE("latency percentiles are bucket bounds capped at the max",
+          "[latency_hist]") {
+    latency_hist_t h = {0};
+    TEST_ASSERT_EQUAL_UINT32(0, latency_hist_percentile(&h, 0, 50));
+
+    // 90 fast runs, 9 at 1 ms, one at 5 ms
+    for (int i = 0; i < 90; ++i) latency_hist_record(&h, 20);
+    for (int i = 0; i < 9; ++i) latency_hist_record(&h, 1000);
+    latency_hist_record(&h, 5000);
+    uint32_t total = latency_hist_count(&h);
+    TEST_ASSERT_EQUAL_UINT32(100, total);
+
+    TEST_ASSERT_EQUAL_UINT32(32, latency_hist_percentile(&h, total, 0));
+    TEST_ASSERT_EQUAL_UINT32(32, latency_hist_percentile(&h, total, 50));
+    TEST_ASSERT_EQUAL_UINT32(32, latency_hist_percentile(&h, total, 90));
+    TEST_ASSERT_EQUAL_UINT32(1024, latency_hist_percentile(&h, total, 91));
+    TEST_ASSERT_EQUAL_UINT32(1024, latency_hist_percentile(&h, total, 99));
+    // The 5 ms run is in the bucket up to 8192 us, capped at the max
+    TEST_ASSERT_EQUAL_UINT32(5000, latency_hist_percentile(&h, total, 100));
+}
+
+TEST_CASE("latency percentiles of a single sample are that sample",
+          "[latency_hist]") {
+    latency_hist_t h = {0};
+    latency_hist_record(&h, 20);
+    TEST_ASSERT_EQUAL_UINT32(20, latency_hist_percentile(&h, 1, 50));
+
+    latency_hist_t slow = {0};
+    latency_hist_record(&slow, 30000000);  // past the last bounded bucket
+    TEST_ASSERT_EQUAL_UINT32(30000000, latency_hist_percentile(&slow, 1, 99));
+}
@@ -0,0 +1,172 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "log_capture.h"
+#include "unity.h"
+
+#define PRODUCER_LINES 2000
+
+static bool push_fmt(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    bool ok = log_capture_vpush(fmt, ap);
+    va_end(ap);
+    return ok;
+}
+
+TEST_CASE("log capture returns lines in order with their metadata",
+          "[log_capture]") {
+    uint32_t first = log_capture_next_seq();
+    TEST_ASSERT_TRUE(log_capture_push("W (12) demo: first"));
+    TEST_ASSERT_TRUE(push_fmt("E (%d) %s: second %d\n", 34, "demo", 2));
+    TEST_ASSERT_EQUAL_UINT32(first + 2, log_capture_next_seq());
+
+    char line[LOG_LINE_MAX];
+    log_capture_meta_t meta;
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_OK,
+                      log_capture_read(first, line, sizeof(line), &meta));
+    TEST_ASSERT_EQUAL_STRING("W (12) demo: first", line);
+    TEST_ASSERT_EQUAL_UINT8(2, meta.level);
+    TEST_ASSERT_EQUAL_UINT32(log_capture_tag_hash("demo"), meta.tag_hash);
+
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_OK,
+                      log_capture_read(first + 1, line, sizeof(line), &meta));
+    TEST_ASSERT_EQUAL_STRING("E (34) demo: second 2", line);
+    TEST_ASSERT_EQUAL_UINT8(1, meta.level);
+
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_PENDING,
+                      log_capture_read(first + 2, line, sizeof(line), NULL));
+}
+
+TEST_CASE("log capture reports overwritten lines as lost", "[log_capture]") {
+    uint32_t first = log_capture_next_seq();
+    TEST_ASSERT_TRUE(log_capture_push("I (1) demo: oldest"));
+    for (int i = 0; i < LOG_HISTORY_LINES; ++i) {
+        TEST_ASSERT_TRUE(push_fmt("I (1) demo: filler %d", i));
+    }
+
+    char line[LOG_LINE_MAX];
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_LOST,
+                      log_capture_read(first, line, sizeof(line), NULL));
+    TEST_ASSERT_EQUAL_STRING("", line);
+
+    uint32_t oldest = log_capture_oldest_seq();
+    TEST_ASSERT_EQUAL_UINT32(log_capture_next_seq() - LOG_HISTORY_LINES,
+                             oldest);
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_OK,
+                      log_capture_read(oldest, line, sizeof(line), NULL));
+    TEST_ASSERT_EQUAL_STRING("I (1) demo: filler 0", line);
+}
+
+TEST_CASE("log capture truncates long lines to the output buffer",
+          "[log_capture]") {
+    char text[LOG_LINE_MAX + 64];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    uint32_t seq = log_capture_next_seq();
+    TEST_ASSERT_TRUE(log_capture_push(text));
+
+    char line[LOG_LINE_MAX];
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_OK,
+                      log_capture_read(seq, line, sizeof(line), NULL));
+    TEST_ASSERT_GREATER_THAN(0, strlen(line));
+    TEST_ASSERT_LESS_THAN(LOG_LINE_MAX, strlen(line));
+    TEST_ASSERT_EQUAL_STRING_LEN(text, line, strlen(line));
+
+    char small[8];
+    TEST_ASSERT_EQUAL(LOG_CAPTURE_OK,
+                      log_capture_read(seq, small, sizeof(small), NULL));
+    TEST_ASSERT_EQUAL_STRING("xxxxxxx", small);
+}
+
+typedef struct {
+    int id;
+    TaskHandle_t waiter;
+    uint32_t dropped;
+} producer_t;
+
+static void producer_task(void* arg) {
+    producer_t* p = (producer_t*)arg;
+    for (unsigned i = 0; i < PRODUCER_LINES; ++i) {
+        if (!push_fmt("I (0) ring_test: producer %d line %u", p->id, i)) {
+            p->dropped++;
+        }
+    }
+    xTaskNotifyGive(p->waiter);
+    vTaskDelete(NULL);
+}
+
+// A line that reads back OK must be exactly one producer's line
+static void check_line(const char* line, int* id, unsigned* n) {
+    int end = 0;
+    TEST_ASSERT_EQUAL_INT(
+        2, sscanf(line, "I (0) ring_test: producer %d line %u%n", id, n, &end));
+    TEST_ASSERT_EQUAL_INT(strlen(line), end);
+    TEST_ASSERT_TRUE(*id >= 0 && *id < portNUM_PROCESSORS);
+    TEST_ASSERT_LESS_THAN(PRODUCER_LINES, *n);
+}
+
+TEST_CASE("log capture keeps lines whole with a producer on every core",
+          "[log_capture]") {
+    uint32_t first = log_capture_next_seq();
+    uint32_t dropped_before = log_capture_dropped();
+
+    producer_t producers[portNUM_PROCESSORS];
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+        producers[core] = (producer_t){
+            .id = core,
+            .waiter = xTaskGetCurrentTaskHandle(),
+        };
+        TEST_ASSERT_EQUAL(
+            pdPASS, xTaskCreatePinnedToCore(producer_task, "ring_test", 3072,
+                                            &producers[core],
+                                            uxTaskPriorityGet(NULL), NULL,
+                                            core));
+    }
+
+    // Read the newest line while the producers run; a torn copy would not
+    // parse
+    char line[LOG_LINE_MAX];
+    int done = 0;
+    while (done < portNUM_PROCESSORS) {
+        done += (int)ulTaskNotifyTake(pdFALSE, 0);
+        uint32_t seq = log_capture_next_seq() - 1;
+        if (seq >= first &&
+            log_capture_read(seq, line, sizeof(line), NULL) ==
+                LOG_CAPTURE_OK) {
+            int id;
+            unsigned n;
+            check_line(line, &id, &n);
+        }
+    }
+
+    uint32_t dropped = 0;
+    for (int i = 0; i < portNUM_PROCESSORS; ++i) {
+        dropped += producers[i].dropped;
+    }
+    TEST_ASSERT_EQUAL_UINT32(portNUM_PROCESSORS * PRODUCER_LINES,
+                             log_capture_next_seq() - first);
+    TEST_ASSERT_EQUAL_UINT32(dropped, log_capture_dropped() - dropped_before);
+
+    // What is left in the ring is whole and in order per producer
+    int64_t last[portNUM_PROCESSORS];
+    for (int i = 0; i < portNUM_PROCESSORS; ++i) last[i] = -1;
+    uint32_t read = 0;
+    for (uint32_t seq = log_capture_oldest_seq();
+         seq != log_capture_next_seq(); ++seq) {
+        log_capture_result_t res =
+            log_capture_read(seq, line, sizeof(line), NULL);
+        if (res == LOG_CAPTURE_LOST) continue;  // dropped by its producer
+        TEST_ASSERT_EQUAL(LOG_CAPTURE_OK, res);
+        int id;
+        unsigned n;
+        check_line(line, &id, &n);
+        TEST_ASSERT_GREATER_THAN(last[id], (int64_t)n);
+        last[id] = n;
+        read++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, read);
+}
@@ -0,0 +1,67 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "log_store.h"
+#include "unity.h"
+
+static void assert_range(const char* value, uint32_t total, uint32_t first,
+                         uint32_t last) {
+    uint32_t f = 0, l = 0;
+    bool unsatisfiable = true;
+    TEST_ASSERT_TRUE_MESSAGE(
+        log_store_parse_range(value, total, &f, &l, &unsatisfiable), value);
+    TEST_ASSERT_FALSE_MESSAGE(unsatisfiable, value);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(first, f, value);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(last, l, value);
+}
+
+static void assert_unsatisfiable(const char* value, uint32_t total) {
+    uint32_t f = 0, l = 0;
+    bool unsatisfiable = false;
+    TEST_ASSERT_TRUE_MESSAGE(
+        log_store_parse_range(value, total, &f, &l, &unsatisfiable), value);
+    TEST_ASSERT_TRUE_MESSAGE(unsatisfiable, value);
+}
+
+static void assert_ignored(const char* value) {
+    uint32_t f = 0, l = 0;
+    bool unsatisfiable = true;
+    TEST_ASSERT_FALSE_MESSAGE(
+        log_store_parse_range(value, 100, &f, &l, &unsatisfiable),
+        value ? value : "NULL");
+    TEST_ASSERT_FALSE(unsatisfiable);
+}
+
+TEST_CASE("log range parser accepts the three single range forms",
+          "[log_store]") {
+    assert_range("bytes=0-9", 100, 0, 9);
+    assert_range("bytes=10-10", 100, 10, 10);
+    assert_range("bytes=90-", 100, 90, 99);
+    assert_range("bytes=-10", 100, 90, 99);
+}
+
+TEST_CASE("log range parser clips ranges to the log", "[log_store]") {
+    assert_range("bytes=50-500", 100, 50, 99);
+    assert_range("bytes=-200", 100, 0, 99);
+    assert_range("bytes=0-0", 1, 0, 0);
+}
+
+TEST_CASE("log range parser reports ranges past the end", "[log_store]") {
+    assert_unsatisfiable("bytes=100-", 100);
+    assert_unsatisfiable("bytes=100-200", 100);
+    assert_unsatisfiable("bytes=-0", 100);
+    assert_unsatisfiable("bytes=0-", 0);
+    assert_unsatisfiable("bytes=-5", 0);
+}
+
+TEST_CASE("log range parser ignores what it does not understand",
+          "[log_store]") {
+    assert_ignored(NULL);
+    assert_ignored("");
+    assert_ignored("items=0-9");
+    assert_ignored("bytes=0-9,20-29");
+    assert_ignored("bytes=5");
+    assert_ignored("bytes=9-3");
+    assert_ignored("bytes=x-3");
+    assert_ignored("bytes=3-x");
+}
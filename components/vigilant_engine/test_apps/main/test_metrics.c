@@ -0,0 +1,22 @@
+#include <string.h>
+
+#include "metrics.h"
+#include "unity.h"
+
+TEST_CASE("metrics escapes label values", "[metrics]") {
+    char buf[32];
+    TEST_ASSERT_EQUAL(14, metrics_escape_label(buf, sizeof(buf),
+                                               "/a\"b\\c\nd{x}"));
+    TEST_ASSERT_EQUAL_STRING("/a\\\"b\\\\c\\nd{x}", buf);
+
+    TEST_ASSERT_EQUAL(0, metrics_escape_label(buf, sizeof(buf), ""));
+    TEST_ASSERT_EQUAL_STRING("", buf);
+}
+
+TEST_CASE("metrics reports a cut-off label value", "[metrics]") {
+    char buf[5];
+    // The result is the full length, so the caller can tell it was cut off
+    TEST_ASSERT_EQUAL(8, metrics_escape_label(buf, sizeof(buf), "/abc\"ef"));
+    TEST_ASSERT_EQUAL_STRING("/abc", buf);
+    TEST_ASSERT_EQUAL(1, metrics_escape_label(buf, 0, "x"));
+}
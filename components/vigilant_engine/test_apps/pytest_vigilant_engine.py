@@ -0,0 +1,9 @@
+import pytest
+from pytest_embedded import Dut
+from pytest_embedded_idf.utils import idf_parametrize
+
+
+@pytest.mark.generic
+@idf_parametrize("target", ["esp32s3", "esp32p4", "esp32c6"], indirect=["target"])
+def test_vigilant_engine_unit(dut: Dut) -> None:
+    dut.run_all_single_board_cases()
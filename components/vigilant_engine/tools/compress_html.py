@@ -0,0 +1,36 @@
+"""Gzip an HTML page for embedding and write its ETag.
+
+Usage: compress_html.py <input.html> <output.gz> <output.etag>
+
+The gzip stream has no file name and a zero timestamp, so the same input
+always gives the same bytes and the ETag only changes with the page.
+"""
+
+import gzip
+import hashlib
+import sys
+
+
+def main() -> int:
+    if len(sys.argv) != 4:
+        print(__doc__.strip().splitlines()[2], file=sys.stderr)
+        return 2
+
+    src, gz_path, etag_path = sys.argv[1:]
+    with open(src, "rb") as f:
+        html = f.read()
+
+    data = gzip.compress(html, compresslevel=9, mtime=0)
+    etag = '"' + hashlib.sha256(data).hexdigest()[:16] + '"'
+
+    with open(gz_path, "wb") as f:
+        f.write(data)
+    with open(etag_path, "w", encoding="ascii", newline="") as f:
+        f.write(etag)
+
+    print(f"{src}: {len(html)} -> {len(data)} bytes, ETag {etag}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,522 @@
+#!/usr/bin/env python3
+"""HTTP and websocket load test for the Vigilant Engine web server.
+
+Usage:
+  loadtest.py [--host H] [--port P] [--http-clients N] [--ws-clients M]
+              [--duration S] [--paths /info,/i2cinfo,/] [--launch CMD]
+              [--output result.json] [--compare baseline.json]
+
+Drives N keep-alive HTTP clients round-robin over the given paths and M /ws
+log subscribers against a running engine (a board, or a host build started
+with --launch), then prints one JSON report: requests per second and latency
+percentiles per path, log lines the subscribers missed, the device's heap
+low-water mark and its own /latency view. With --compare the report is
+checked against an earlier one and the exit status is 1 on a regression.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import base64
+import datetime
+import hashlib
+import http.client
+import json
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+REPORT_VERSION = 1
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+
+def percentile(sorted_values, pct):
+    """Nearest-rank percentile of an already sorted list."""
+    if not sorted_values:
+        return 0.0
+    rank = max(1, -(-len(sorted_values) * pct // 100))
+    return sorted_values[int(rank) - 1]
+
+
+class PathStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = []
+        self.status = {}
+        self.errors = 0
+
+    def record(self, seconds, status):
+        with self.lock:
+            self.latencies.append(seconds)
+            self.status[status] = self.status.get(status, 0) + 1
+
+    def error(self):
+        with self.lock:
+            self.errors += 1
+
+    def summary(self, duration):
+        with self.lock:
+            lat = sorted(self.latencies)
+            ok = sum(n for s, n in self.status.items() if s < 400)
+            return {
+                "requests": len(lat),
+                "ok": ok,
+                "errors": self.errors,
+                "status": {str(s): n for s, n in sorted(self.status.items())},
+                "rps": round(ok / duration, 2) if duration > 0 else 0.0,
+                "latency_ms": {
+                    "p50": round(percentile(lat, 50) * 1000, 2),
+                    "p90": round(percentile(lat, 90) * 1000, 2),
+                    "p99": round(percentile(lat, 99) * 1000, 2),
+                    "max": round(lat[-1] * 1000, 2) if lat else 0.0,
+                },
+            }
+
+
+def http_client(host, port, paths, offset, deadline, stats, timeout):
+    """One keep-alive connection; reconnects after errors or closes."""
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    i = offset
+    while time.monotonic() < deadline:
+        path = paths[i % len(paths)]
+        i += 1
+        start = time.perf_counter()
+        try:
+            conn.request("GET", path, headers={"Accept-Encoding": "gzip"})
+            resp = conn.getresponse()
+            resp.read()
+            stats[path].record(time.perf_counter() - start, resp.status)
+            if resp.will_close:
+                conn.close()
+        except (OSError, http.client.HTTPException):
+            stats[path].error()
+            conn.close()
+            time.sleep(0.05)
+    conn.close()
+
+
+class WsConnection:
+    """Minimal RFC 6455 client: text frames, fragmentation, ping/pong."""
+
+    def __init__(self, host, port, path, timeout):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall(
+            (
+                f"GET {path} HTTP/1.1\r\nHost: {host}:{port}\r\n"
+                "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n"
+            ).encode()
+        )
+        head = b""
+        while b"\r\n\r\n" not in head:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise ConnectionError("handshake closed")
+            head += chunk
+        head, self.buf = head.split(b"\r\n\r\n", 1)
+        accept = base64.b64encode(
+            hashlib.sha1((key + WS_GUID).encode()).digest()
+        ).decode()
+        if b" 101 " not in head.split(b"\r\n", 1)[0] or accept.encode() not in head:
+            raise ConnectionError("handshake rejected")
+
+    def _read(self, n):
+        while len(self.buf) < n:
+            chunk = self.sock.recv(max(4096, n - len(self.buf)))
+            if not chunk:
+                raise ConnectionError("closed")
+            self.buf += chunk
+        data, self.buf = self.buf[:n], self.buf[n:]
+        return data
+
+    def send(self, opcode, payload):
+        mask = os.urandom(4)
+        n = len(payload)
+        if n < 126:
+            head = struct.pack("!BB", 0x80 | opcode, 0x80 | n)
+        elif n < 65536:
+            head = struct.pack("!BBH", 0x80 | opcode, 0x80 | 126, n)
+        else:
+            head = struct.pack("!BBQ", 0x80 | opcode, 0x80 | 127, n)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(head + mask + masked)
+
+    def recv_message(self):
+        """Returns one complete text message, answering pings on the way."""
+        parts = []
+        while True:
+            b0, b1 = self._read(2)
+            opcode = b0 & 0x0F
+            n = b1 & 0x7F
+            if n == 126:
+                (n,) = struct.unpack("!H", self._read(2))
+            elif n == 127:
+                (n,) = struct.unpack("!Q", self._read(8))
+            payload = self._read(n)
+            if opcode == 0x8:
+                raise ConnectionError("closed by device")
+            if opcode == 0x9:
+                self.send(0xA, payload)
+                continue
+            if opcode in (0x1, 0x0):
+                parts.append(payload)
+                if b0 & 0x80:
+                    return b"".join(parts).decode("utf-8", "replace")
+
+    def close(self):
+        try:
+            self.send(0x8, b"")
+        except OSError:
+            pass
+        self.sock.close()
+
+
+class WsStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.connected = 0
+        self.disconnects = 0
+        self.messages = 0
+        self.bytes = 0
+        self.lines = 0
+        self.missed = 0
+
+    def summary(self, duration):
+        with self.lock:
+            return {
+                "connected": self.connected,
+                "disconnects": self.disconnects,
+                "messages": self.messages,
+                "bytes": self.bytes,
+                "log_lines": self.lines,
+                "log_lines_per_s": round(self.lines / duration, 2)
+                if duration > 0
+                else 0.0,
+                "log_lines_missed": self.missed,
+            }
+
+
+def ws_subscriber(host, port, deadline, stats, timeout):
+    """Follows the log stream like the dashboard does and counts lines that
+    never arrived: the sequence advanced by more than the lines received.
+    That includes lines the device itself does not stream (its own httpd
+    errors) and "gap" reports after a client fell out of the ring."""
+    try:
+        ws = WsConnection(host, port, "/ws", timeout)
+    except (OSError, ConnectionError):
+        with stats.lock:
+            stats.disconnects += 1
+        return
+    with stats.lock:
+        stats.connected += 1
+
+    cursor = None
+    ws.sock.settimeout(1.0)
+    try:
+        while time.monotonic() < deadline:
+            try:
+                text = ws.recv_message()
+            except socket.timeout:
+                continue
+            try:
+                msg = json.loads(text)
+            except ValueError:
+                continue
+            lines = msg.get("lines") if msg.get("type") == "logs" else None
+            with stats.lock:
+                stats.messages += 1
+                stats.bytes += len(text)
+                if lines is None:
+                    continue
+                stats.lines += len(lines)
+                nxt = msg.get("next")
+                if msg.get("append") and cursor is not None and nxt is not None:
+                    # Covers any "gap" in this message as well
+                    stats.missed += max(0, (nxt - cursor) - len(lines))
+                else:
+                    stats.missed += msg.get("gap", 0)
+                if nxt is not None:
+                    cursor = nxt
+    except (OSError, ConnectionError):
+        with stats.lock:
+            stats.disconnects += 1
+    finally:
+        ws.close()
+
+
+def parse_metrics(text):
+    samples = {}
+    for line in text.splitlines():
+        if not line or line.startswith("#"):
+            continue
+        name, _, value = line.rpartition(" ")
+        try:
+            samples[name] = float(value)
+        except ValueError:
+            pass
+    return samples
+
+
+def fetch(host, port, path, timeout):
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        conn.request("GET", path)
+        resp = conn.getresponse()
+        body = resp.read()
+        return resp.status, body.decode("utf-8", "replace")
+    finally:
+        conn.close()
+
+
+class DeviceSampler(threading.Thread):
+    """Polls /metrics for the heap low-water mark during the run."""
+
+    def __init__(self, host, port, interval, timeout):
+        super().__init__(daemon=True)
+        self.host, self.port = host, port
+        self.interval = interval
+        self.timeout = timeout
+        self.stop = threading.Event()
+        self.heap_free_min = None
+        self.samples = 0
+
+    def read(self):
+        try:
+            status, body = fetch(self.host, self.port, "/metrics", self.timeout)
+        except (OSError, http.client.HTTPException):
+            return {}
+        return parse_metrics(body) if status == 200 else {}
+
+    def run(self):
+        while not self.stop.wait(self.interval):
+            free = self.read().get("ve_heap_free_bytes")
+            if free is not None:
+                self.samples += 1
+                if self.heap_free_min is None or free < self.heap_free_min:
+                    self.heap_free_min = free
+
+
+def wait_for_port(host, port, seconds):
+    deadline = time.monotonic() + seconds
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection((host, port), timeout=1).close()
+            return True
+        except OSError:
+            time.sleep(0.2)
+    return False
+
+
+def stop(proc):
+    try:
+        os.killpg(proc.pid, signal.SIGTERM)
+        proc.wait(timeout=10)
+    except ProcessLookupError:
+        pass
+    except subprocess.TimeoutExpired:
+        os.killpg(proc.pid, signal.SIGKILL)
+        proc.wait()
+
+
+def git_revision():
+    try:
+        return subprocess.run(
+            ["git", "rev-parse", "--short", "HEAD"],
+            capture_output=True,
+            text=True,
+            check=True,
+            cwd=os.path.dirname(os.path.abspath(__file__)),
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def run(args):
+    paths = [p for p in args.paths.split(",") if p]
+    sampler = DeviceSampler(args.host, args.port, args.sample_interval, args.timeout)
+    before = sampler.read()
+    if not before:
+        print(f"warning: no /metrics on {args.host}:{args.port}", file=sys.stderr)
+
+    http_stats = {p: PathStats() for p in paths}
+    ws_stats = WsStats()
+    started = datetime.datetime.now(datetime.timezone.utc)
+    t0 = time.monotonic()
+    deadline = t0 + args.duration
+
+    threads = [
+        threading.Thread(
+            target=ws_subscriber,
+            args=(args.host, args.port, deadline, ws_stats, args.timeout),
+        )
+        for _ in range(args.ws_clients)
+    ]
+    threads += [
+        threading.Thread(
+            target=http_client,
+            args=(args.host, args.port, paths, i, deadline, http_stats, args.timeout),
+        )
+        for i in range(args.http_clients)
+    ]
+    sampler.start()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    duration = time.monotonic() - t0
+    sampler.stop.set()
+    sampler.join()
+
+    after = sampler.read()
+    try:
+        status, body = fetch(args.host, args.port, "/latency", args.timeout)
+        device_latency = json.loads(body).get("uris") if status == 200 else None
+    except (OSError, ValueError, http.client.HTTPException):
+        device_latency = None
+
+    per_path = {p: s.summary(duration) for p, s in http_stats.items()}
+    ok = sum(s["ok"] for s in per_path.values())
+    all_lat = sorted(l for s in http_stats.values() for l in s.latencies)
+    heap_start = before.get("ve_heap_free_bytes")
+    heap_min = sampler.heap_free_min
+    heap_low_water = after.get("ve_heap_min_free_bytes")
+
+    def delta(name):
+        if name in before and name in after:
+            return int(after[name] - before[name])
+        return None
+
+    return {
+        "version": REPORT_VERSION,
+        "target": f"{args.host}:{args.port}",
+        "git": git_revision(),
+        "started": started.isoformat(timespec="seconds"),
+        "duration_s": round(duration, 2),
+        "config": {
+            "http_clients": args.http_clients,
+            "ws_clients": args.ws_clients,
+            "paths": paths,
+        },
+        "http": {
+            "requests": sum(s["requests"] for s in per_path.values()),
+            "errors": sum(s["errors"] for s in per_path.values()),
+            "rps": round(ok / duration, 2) if duration > 0 else 0.0,
+            "latency_ms": {
+                "p50": round(percentile(all_lat, 50) * 1000, 2),
+                "p90": round(percentile(all_lat, 90) * 1000, 2),
+                "p99": round(percentile(all_lat, 99) * 1000, 2),
+                "max": round(all_lat[-1] * 1000, 2) if all_lat else 0.0,
+            },
+            "per_path": per_path,
+        },
+        "ws": ws_stats.summary(duration),
+        "device": {
+            "heap_free_start": heap_start,
+            "heap_free_min_sampled": heap_min,
+            "heap_min_free_since_boot": heap_low_water,
+            "peak_heap_used_by_run": int(heap_start - heap_min)
+            if heap_start is not None and heap_min is not None
+            else None,
+            "log_lines_dropped": delta("ve_log_dropped_total"),
+            "ws_batches_skipped": delta("ve_ws_batches_skipped_total"),
+            "ws_frames_dropped": delta("ve_ws_frames_dropped_total"),
+            "latency": device_latency,
+        },
+    }
+
+
+def compare(report, baseline, tolerance):
+    """Lists regressions beyond `tolerance` (a fraction) against a baseline."""
+    problems = []
+
+    def check(name, new, old, higher_is_better):
+        if new is None or old is None or old == 0:
+            return
+        change = (new - old) / old
+        worse = -change if higher_is_better else change
+        if worse > tolerance:
+            problems.append(f"{name}: {old} -> {new} ({change:+.0%})")
+
+    check("http.rps", report["http"]["rps"], baseline["http"]["rps"], True)
+    for path, stats in report["http"]["per_path"].items():
+        old = baseline["http"]["per_path"].get(path)
+        if old:
+            check(f"{path} p99_ms", stats["latency_ms"]["p99"],
+                  old["latency_ms"]["p99"], False)
+            check(f"{path} rps", stats["rps"], old["rps"], True)
+    check("device.peak_heap_used_by_run",
+          report["device"]["peak_heap_used_by_run"],
+          baseline["device"]["peak_heap_used_by_run"], False)
+    if report["ws"]["log_lines_missed"] > baseline["ws"]["log_lines_missed"]:
+        problems.append(
+            "ws.log_lines_missed: "
+            f"{baseline['ws']['log_lines_missed']} -> {report['ws']['log_lines_missed']}"
+        )
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__.strip().splitlines()[0],
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+    )
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--http-clients", type=int, default=4)
+    parser.add_argument("--ws-clients", type=int, default=2)
+    parser.add_argument("--duration", type=float, default=30.0)
+    parser.add_argument("--paths", default="/info,/i2cinfo,/")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--sample-interval", type=float, default=1.0)
+    parser.add_argument(
+        "--launch",
+        help="command that starts the engine (e.g. a linux target build); "
+        "stopped after the run",
+    )
+    parser.add_argument("--output", help="also write the report to this file")
+    parser.add_argument("--compare", help="baseline report to check against")
+    parser.add_argument(
+        "--tolerance",
+        type=float,
+        default=0.10,
+        help="allowed regression against --compare (default 0.10 = 10%%)",
+    )
+    args = parser.parse_args()
+
+    proc = None
+    if args.launch:
+        # Own process group, so the shell and whatever it started stop together
+        proc = subprocess.Popen(args.launch, shell=True, start_new_session=True)
+        if not wait_for_port(args.host, args.port, 30):
+            stop(proc)
+            print("error: engine did not open its port", file=sys.stderr)
+            return 2
+    try:
+        report = run(args)
+    finally:
+        if proc:
+            stop(proc)
+
+    text = json.dumps(report, indent=2)
+    print(text)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            f.write(text + "\n")
+
+    if args.compare:
+        with open(args.compare, encoding="utf-8") as f:
+            problems = compare(report, json.load(f), args.tolerance)
+        for p in problems:
+            print(f"regression: {p}", file=sys.stderr)
+        return 1 if problems else 0
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
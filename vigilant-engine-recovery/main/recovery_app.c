@@ -14,6 +14,7 @@
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "http_cache.h"
 #include "nvs_flash.h"
 #include "sdkconfig.h"
 
@@ -63,8 +64,11 @@ typedef enum {
 // ---- OTA ----
 #define OTA_BUF_SIZE 2048
 
-extern const unsigned char index_html_start[] asm("_binary_index_html_start");
-extern const unsigned char index_html_end[] asm("_binary_index_html_end");
+// gzip page and its quoted ETag, see components/vigilant_engine/tools
+extern const unsigned char index_html_gz_start[] asm(
+    "_binary_index_html_gz_start");
+extern const unsigned char index_html_gz_end[] asm("_binary_index_html_gz_end");
+extern const char index_html_etag[] asm("_binary_index_html_etag_start");
 
 static volatile bool s_sta_has_ip = false;
 
@@ -92,11 +96,9 @@ static const char* recovery_mode_name(void) {
 }
 
 static esp_err_t index_get_handler(httpd_req_t* req) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
-
-    return httpd_resp_send(req, (const char*)index_html_start,
-                           index_html_end - index_html_start);
+    return http_cache_send_gzip(req, "text/html", index_html_gz_start,
+                                index_html_gz_end - index_html_gz_start,
+                                index_html_etag);
 }
 
 static const esp_partition_t* find_ota0_partition(void) {